@@ -0,0 +1,99 @@
+#include <new>
+#include <atomic>
+#include <random>
+#include <string>
+#include <iostream>
+#include "Scale.h"
+
+// Checks that repeated scales into the caller's view allocate nothing once the scaler is warmed up,
+// for every method the row scaler handles, with and without linear light, in each 8-bit layout. Exits with 1 when one does
+
+// Every allocation the program makes
+static std::atomic<Uint64> allocations = 0;
+
+void* operator new(const size_t size) {
+	++allocations;
+	if (void* memory = std::malloc(size == 0 ? 1 : size)) { return memory; }
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, const size_t) noexcept { std::free(memory); }
+
+const std::string MethodName(const ScaleMethod method) {
+
+	switch (method) {
+	case ScaleMethod::NearestNeighbor:
+		return "NearestNeighbor";
+	case ScaleMethod::Bilinear:
+		return "Bilinear";
+	case ScaleMethod::Area:
+		return "Area";
+	default:
+		return "Unknown";
+	}
+}
+
+const std::string FormatName(const PixelFormat format) {
+
+	switch (format) {
+	case PixelFormat::BGRA32:
+		return "BGRA32";
+	case PixelFormat::BGR24:
+		return "BGR24";
+	case PixelFormat::Gray8:
+		return "Gray8";
+	default:
+		return "Unknown";
+	}
+}
+
+// Allocations made by runs repeated scales of source into scaled, after one to warm the scaler up
+Uint64 SteadyStateAllocations(Scaler& scaler, const ConstImageView& source, ImageBuffer& scaled) {
+
+	constexpr const int runs = 10;
+
+	scaler.Scale(source, scaled.View());
+
+	const Uint64 before = allocations;
+	for (int run = 0; run < runs; ++run) {
+		scaler.Scale(source, scaled.View());
+	}
+
+	return allocations - before;
+}
+
+int main(int argc, char** argv) {
+
+	std::mt19937 random;
+	bool passed = true;
+
+	for (const PixelFormat format : { PixelFormat::BGRA32, PixelFormat::BGR24, PixelFormat::Gray8 }) {
+
+		PixelData pixels((size_t)RES_720.width * RES_720.height * BytesPerPixel(format));
+		for (MyByte& byte : pixels) { byte = (MyByte)random(); }
+		const ImageBuffer source(std::move(pixels), RES_720, format);
+
+		for (const Resolution& targetRes : { RES_1080, Resolution { 640, 360 } }) {
+
+			ImageBuffer scaled(targetRes, format);
+
+			for (const ScaleMethod method : { ScaleMethod::NearestNeighbor, ScaleMethod::Bilinear, ScaleMethod::Area }) {
+				for (const bool linearLight : { false, true }) {
+
+					Scaler scaler(method, linearLight);
+					const Uint64 made = SteadyStateAllocations(scaler, source, scaled);
+
+					if (made == 0) { continue; }
+
+					passed = false;
+					std::cout << "Allocated " << made << " times scaling " << FormatName(format) << " to " << targetRes.width
+						<< "x" << targetRes.height << " with " << MethodName(method) << (linearLight ? " linear" : "") << std::endl;
+				}
+			}
+		}
+	}
+
+	std::cout << (passed ? "Repeated scales allocate nothing" : "Repeated scales allocate") << std::endl;
+	return passed ? 0 : 1;
+}
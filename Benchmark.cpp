@@ -0,0 +1,195 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <iomanip>
+#include <iostream>
+#include "Scale.h"
+#include "Convert.h"
+
+// Scales synthetic frames of growing width to 1080p so no display is needed, reports destination megapixels per second
+// of each frame in BGRA32 and in BGRA64, and how many times faster BGRA32 is.
+// Then converts a 4K frame between pixel formats and to YUV, next to a memcpy of the same frame.
+// Exits with 1 when a conversion falls below its floor, a share of the memcpy speed
+
+// Share of the memcpy speed every format conversion has to reach, the scalar loops reach about a quarter
+constexpr const double CONVERSION_FLOOR = 0.4;
+
+// Share of the memcpy speed every YUV conversion has to reach, the scalar loop reaches under a tenth
+constexpr const double YUV_FLOOR = 0.25;
+
+const std::string MethodName(const ScaleMethod method) {
+
+	switch (method) {
+	case ScaleMethod::NearestNeighbor:
+		return "NearestNeighbor";
+	case ScaleMethod::Bilinear:
+		return "Bilinear";
+	case ScaleMethod::Area:
+		return "Area";
+	default:
+		return "Unknown";
+	}
+}
+
+double MegapixelsPerSecond(Scaler& scaler, const ConstImageView& source, ImageBuffer& scaled) {
+
+	constexpr const int runs = 5;
+
+	// First run builds the scaler's tables
+	scaler.Scale(source, scaled.View());
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < runs; ++run) {
+		scaler.Scale(source, scaled.View());
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	const double seconds = std::chrono::duration<double>(end - begin).count();
+	const double megapixels = scaled.GetResolution().width * (double)scaled.GetResolution().height / 1e6;
+
+	return megapixels * runs / seconds;
+}
+
+const std::string FormatName(const PixelFormat format) {
+
+	switch (format) {
+	case PixelFormat::BGRA32:
+		return "BGRA32";
+	case PixelFormat::RGBA32:
+		return "RGBA32";
+	case PixelFormat::ARGB32:
+		return "ARGB32";
+	case PixelFormat::BGR24:
+		return "BGR24";
+	case PixelFormat::RGB24:
+		return "RGB24";
+	case PixelFormat::Gray8:
+		return "Gray8";
+	default:
+		return "Unknown";
+	}
+}
+
+// Source gigabytes per second of either converting or copying source
+double GigabytesPerSecond(const ConstImageView& source, ImageBuffer& converted) {
+
+	constexpr const int runs = 20;
+
+	Convert(source, converted.View());
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < runs; ++run) {
+		Convert(source, converted.View());
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	const double seconds = std::chrono::duration<double>(end - begin).count();
+
+	return source.PackedSize() * runs / seconds / 1e9;
+}
+
+// Source gigabytes per second of converting source to a 4:2:0 frame
+double YuvGigabytesPerSecond(const ConstImageView& source, const YuvLayout layout) {
+
+	constexpr const int runs = 20;
+
+	YuvFrame frame(source.resolution, layout);
+	ToYuv(source, frame);
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < runs; ++run) {
+		ToYuv(source, frame);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	const double seconds = std::chrono::duration<double>(end - begin).count();
+
+	return source.PackedSize() * runs / seconds / 1e9;
+}
+
+bool BenchmarkConversions(std::mt19937& random) {
+
+	bool passed = true;
+
+	constexpr std::array<PixelFormat, 5> formats { PixelFormat::BGRA32, PixelFormat::RGBA32, PixelFormat::ARGB32,
+		PixelFormat::BGR24, PixelFormat::RGB24 };
+
+	for (const PixelFormat from : formats) {
+
+		PixelData pixels((size_t)RES_4K.width * RES_4K.height * BytesPerPixel(from));
+		for (MyByte& byte : pixels) { byte = (MyByte)random(); }
+		const ImageBuffer source(std::move(pixels), RES_4K, from);
+
+		// Same format is a plain copy, the speed every conversion is aiming for
+		ImageBuffer copy(RES_4K, from);
+		const double memcpySpeed = GigabytesPerSecond(source, copy);
+
+		for (const PixelFormat to : formats) {
+
+			if (to == from) { continue; }
+
+			ImageBuffer converted(RES_4K, to);
+			const double speed = GigabytesPerSecond(source, converted);
+			const bool fast = speed >= memcpySpeed * CONVERSION_FLOOR;
+
+			std::cout << std::setw(6) << FormatName(from) << " -> " << std::setw(6) << FormatName(to)
+				<< "  " << std::setw(6) << speed << " GB/s"
+				<< "  memcpy " << std::setw(6) << memcpySpeed << " GB/s" << (fast ? "" : "  too slow") << std::endl;
+
+			passed = passed && fast;
+		}
+
+		const double i420Speed = YuvGigabytesPerSecond(source, YuvLayout::I420);
+		const double nv12Speed = YuvGigabytesPerSecond(source, YuvLayout::NV12);
+		const bool fast = std::min(i420Speed, nv12Speed) >= memcpySpeed * YUV_FLOOR;
+
+		std::cout << std::setw(6) << FormatName(from) << " ->   I420  " << std::setw(6) << i420Speed << " GB/s"
+			<< "  NV12 " << std::setw(6) << nv12Speed << " GB/s" << (fast ? "" : "  too slow") << std::endl;
+
+		passed = passed && fast;
+	}
+
+	return passed;
+}
+
+int main(int argc, char** argv) {
+
+	std::mt19937 random;
+	std::cout << std::fixed << std::setprecision(1);
+
+	for (const int width : { 1024, 2048, 4096, 8192, 16384 }) {
+
+		const Resolution sourceRes { width, width * 9 / 16 };
+		const Resolution targetRes = RES_1080;
+
+		PixelData pixels((size_t)sourceRes.width * sourceRes.height * NUM_COLOR_CHANNELS);
+		for (MyByte& byte : pixels) { byte = (MyByte)random(); }
+
+		// The same frame in deep colour, each byte widened to 16 bits
+		PixelData deepPixels(pixels.size() * 2);
+		for (size_t sample = 0; sample < pixels.size(); ++sample) {
+			const Ushort deep = (Ubyte)pixels[sample] * 257;
+			std::memcpy(&deepPixels[sample * 2], &deep, sizeof(deep));
+		}
+
+		const ImageBuffer source(std::move(pixels), sourceRes);
+		const ImageBuffer deepSource(std::move(deepPixels), sourceRes, PixelFormat::BGRA64);
+
+		ImageBuffer scaled(targetRes);
+		ImageBuffer deepScaled(targetRes, PixelFormat::BGRA64);
+
+		for (const ScaleMethod method : { ScaleMethod::NearestNeighbor, ScaleMethod::Bilinear, ScaleMethod::Area }) {
+
+			Scaler scaler(method);
+			const double speed = MegapixelsPerSecond(scaler, source, scaled);
+			const double deepSpeed = MegapixelsPerSecond(scaler, deepSource, deepScaled);
+
+			std::cout << std::setw(6) << width << " " << std::setw(16) << MethodName(method)
+				<< "  BGRA32 " << std::setw(8) << speed << " MP/s"
+				<< "  BGRA64 " << std::setw(8) << deepSpeed << " MP/s"
+				<< "  " << std::setw(4) << speed / deepSpeed << "x" << std::endl;
+		}
+	}
+
+	return BenchmarkConversions(random) ? 0 : 1;
+}
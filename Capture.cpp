@@ -93,10 +93,36 @@ ScreenCapture::~ScreenCapture() {
 }
 
 
-ScreenCapture::ScreenCapture(const ScreenCapture& other) : ScreenCapture(other._resolution) {}
+ScreenCapture::ScreenCapture(const ScreenCapture& other) : ScreenCapture(other._resolution) {
+    _scaler.method = other._scaler.method;
+    _scaler.linearLight = other._scaler.linearLight;
+    SetBitsPerPixel(other._bitsPerPixel);
+    CollectStats(other._collectStats, other._statsCollector.CountsHistograms());
+}
 
 const Resolution& ScreenCapture::GetResolution() const { return _resolution; }
 
+Scaler& ScreenCapture::GetScaler() { return _scaler; }
+
+ConstImageView ScreenCapture::View() const {
+    return const_cast<ScreenCapture*>(this)->PixelView();
+}
+
+ImageView ScreenCapture::PixelView() {
+    const PixelFormat format = _bitsPerPixel == 24 ? PixelFormat::BGR24 : PixelFormat::BGRA32;
+    return { _pixelData.data(), _resolution, CalculateBMPFileSize({ _resolution.width, 1 }, _bitsPerPixel), format };
+}
+
+void ScreenCapture::SetBitsPerPixel(const Ushort bitsPerPixel) {
+
+    if (bitsPerPixel != 24 && bitsPerPixel != 32) { return; }
+
+    _bitsPerPixel = bitsPerPixel;
+    Resize(_resolution);
+}
+
+Ushort ScreenCapture::GetBitsPerPixel() const { return _bitsPerPixel; }
+
 void ScreenCapture::Resize(const Resolution& resolution) {
 
     _resolution = resolution;
@@ -127,7 +153,10 @@ void ScreenCapture::Resize(const Resolution& resolution) {
     CGImageRelease(_image);
     CGContextRelease(_context); 
 
-    _context = CGBitmapContextCreate(_pixelData.data(), _resolution.width, _resolution.height,
+    // The context can only draw 32-bit pixels, 24-bit captures are packed afterwards
+    if (_bitsPerPixel == 24) { _contextPixels.resize(_resolution.width * NUM_COLOR_CHANNELS * _resolution.height); }
+
+    _context = CGBitmapContextCreate(_bitsPerPixel == 24 ? _contextPixels.data() : _pixelData.data(), _resolution.width, _resolution.height,
         BITS_PER_CHANNEL, _resolution.width * NUM_COLOR_CHANNELS, _colorspace, kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
 
 #endif
@@ -146,7 +175,13 @@ const PixelData ScreenCapture::WholeDeal() const {
 
 const PixelData& ScreenCapture::CaptureScreen() {
 
-    const Resolution& captureAreaRes = static_cast<Resolution>(_captureArea);
+    Capture(BeginStats(View().format));
+    EndStats();
+
+    return _pixelData;
+}
+
+void ScreenCapture::Capture(StatsCollector* stats) {
 
 #if defined(_WIN32)
 
@@ -163,26 +198,283 @@ const PixelData& ScreenCapture::CaptureScreen() {
         _pixelData.data(),
         (BITMAPINFO*)(&_header[BMP_FILE_HEADER_SIZE]), DIB_RGB_COLORS);
 
+    // The copy happens inside GetDIBits, the pixels are as fresh as they get
+    if (stats != nullptr) { stats->Add(View()); }
+
 #elif defined(__APPLE__)
 
+    const Resolution& captureAreaRes = static_cast<Resolution>(_captureArea);
+
 	_image = CGDisplayCreateImageForRect(CGMainDisplayID(), 
         CGRectMake(_captureArea.left, _captureArea.top, captureAreaRes.width, captureAreaRes.height));
     CGContextDrawImage(_context, CGRectMake(0, 0,
         _resolution.width, _resolution.height), _image);
 
-#elif defined(__linux__)
+    if (_bitsPerPixel == 24) { Convert(ConstImageView(_contextPixels.data(), _resolution), PixelView(), stats); }
+    else if (stats != nullptr) { stats->Add(View()); }
 
-    _image = XGetImage(_display, _root, _captureArea.left, _captureArea.top, 
-        captureAreaRes.width, captureAreaRes.height, AllPlanes, ZPixmap);   
+#elif defined(__linux__)
 
-    _pixelData = PixelData(_image->data, _image->data + CalculateBMPFileSize(captureAreaRes));
-    _pixelData = Scaler::Scale(_pixelData, captureAreaRes, _resolution);
+    CaptureInto(PixelView(), stats);
         
 #endif
+}
 
-    return _pixelData;
+StatsCollector* ScreenCapture::BeginStats(const PixelFormat format) {
+
+    if (!_collectStats) { return nullptr; }
+
+    _statsCollector.Reset(format);
+    return &_statsCollector;
+}
+
+void ScreenCapture::EndStats() {
+    if (_collectStats) { _stats = _statsCollector.Result(); }
+}
+
+void ScreenCapture::CollectStats(const bool collect, const bool histograms) {
+    _collectStats = collect;
+    _statsCollector = StatsCollector(PixelFormat::BGRA32, histograms);
+    _stats = {};
+}
+
+const FrameStats& ScreenCapture::Stats() const { return _stats; }
+
+#if defined(__linux__)
+
+void ScreenCapture::GrabImage() {
+
+    const Resolution& captureAreaRes = static_cast<Resolution>(_captureArea);
+
+    // Reuse the last XImage when the capture area is the same size
+    if (_image != nullptr && _image->width == captureAreaRes.width && _image->height == captureAreaRes.height) {
+        XGetSubImage(_display, _root, _captureArea.left, _captureArea.top,
+            captureAreaRes.width, captureAreaRes.height, AllPlanes, ZPixmap, _image, 0, 0);
+    }
+    else {
+        if (_image != nullptr) { XDestroyImage(_image); }
+
+        _image = XGetImage(_display, _root, _captureArea.left, _captureArea.top, 
+            captureAreaRes.width, captureAreaRes.height, AllPlanes, ZPixmap);   
+    }
+}
+
+void ScreenCapture::CaptureInto(const ImageView& dest, StatsCollector* stats) {
+
+    const Resolution& captureAreaRes = static_cast<Resolution>(_captureArea);
+
+    GrabImage();
+
+    // The XImage's rows can be padded
+    const ConstImageView captured(_image->data, captureAreaRes, _image->bytes_per_line);
+
+    if (dest.format == PixelFormat::BGRA32) {
+        _scaler.Scale(captured, dest, stats);
+        return;
+    }
+
+    if (captureAreaRes == dest.resolution) {
+        Convert(captured, dest, stats);
+        return;
+    }
+
+    // Convert on the way out of the XImage, so scaling has fewer bytes to read
+    if (RowScaler::Supports(_scaler.method)) {
+
+        _convertedCapture.resize(captureAreaRes.width * BytesPerPixel(dest.format) * captureAreaRes.height);
+        const ImageView converted(_convertedCapture.data(), captureAreaRes, dest.format);
+
+        Convert(captured, converted);
+        _scaler.Scale(converted, dest, stats);
+        return;
+    }
+
+    _scaledCapture.resize(dest.resolution.width * BytesPerPixel(PixelFormat::BGRA32) * dest.resolution.height);
+    const ImageView scaled(_scaledCapture.data(), dest.resolution);
+
+    _scaler.Scale(captured, scaled);
+    Convert(scaled, dest, stats);
+}
+
+// Every value of the channel under mask stretched to 16 bits
+static std::vector<Ushort> WidenTable(const unsigned long mask) {
+
+    const int bits = std::popcount(mask);
+    const Uint32 largest = (1u << bits) - 1;
+
+    std::vector<Ushort> table(largest + 1);
+    for (Uint32 value = 0; value <= largest; ++value) {
+        table[value] = static_cast<Ushort>((value * 65535 + largest / 2) / largest);
+    }
+
+    return table;
+}
+
+#endif
+
+ConstImageView ScreenCapture::CaptureScreen(const PixelFormat format) {
+
+    if (format == View().format) {
+        CaptureScreen();
+        return View();
+    }
+
+    if (format == PixelFormat::BGRA64) { return CaptureScreenDeep(); }
+
+    if (!CanConvert(PixelFormat::BGRA32, format)) { return {}; }
+
+    _convertedPixelData.resize(_resolution.width * BytesPerPixel(format) * _resolution.height);
+    const ImageView converted(_convertedPixelData.data(), _resolution, format);
+
+#if defined(__linux__)
+
+    // Straight out of the XImage, skipping the capture buffer
+    CaptureInto(converted, BeginStats(format));
+
+#else
+
+    Capture(nullptr);
+    Convert(View(), converted, BeginStats(format));
+
+#endif
+
+    EndStats();
+
+    return converted;
+}
+
+ConstImageView ScreenCapture::CaptureScreenDeep() {
+
+    _deepPixelData.resize(_resolution.width * BytesPerPixel(PixelFormat::BGRA64) * _resolution.height);
+    const ImageView deepView(_deepPixelData.data(), _resolution, PixelFormat::BGRA64);
+
+#if defined(__linux__)
+
+    const Resolution& captureAreaRes = static_cast<Resolution>(_captureArea);
+
+    GrabImage();
+
+    // Whatever depth the visual has, its masks say where each channel sits
+    const std::array<unsigned long, 3> masks { _image->blue_mask, _image->green_mask, _image->red_mask };
+    const std::array<std::vector<Ushort>, 3> tables { WidenTable(masks[0]), WidenTable(masks[1]), WidenTable(masks[2]) };
+    const std::array<int, 3> shifts { std::countr_zero(masks[0]), std::countr_zero(masks[1]), std::countr_zero(masks[2]) };
+
+    // Widen straight into the result when there is nothing to scale
+    const bool scaling = captureAreaRes != _resolution;
+
+    if (scaling) {
+        _deepCapture.resize(captureAreaRes.width * BytesPerPixel(PixelFormat::BGRA64) * captureAreaRes.height);
+    }
+
+    const ImageView widened = scaling ? ImageView(_deepCapture.data(), captureAreaRes, PixelFormat::BGRA64) : deepView;
+
+    for (int y = 0; y < captureAreaRes.height; ++y) {
+
+        const char* row = _image->data + y * _image->bytes_per_line;
+        Ushort* wideRow = reinterpret_cast<Ushort*>(widened.Row(y));
+
+        for (int x = 0; x < captureAreaRes.width; ++x) {
+
+            // 24 and 30-bit visuals both store a pixel in 32 bits
+            Uint32 pixel;
+            if (_image->bits_per_pixel == 32) { std::memcpy(&pixel, row + x * sizeof(pixel), sizeof(pixel)); }
+            else { pixel = static_cast<Uint32>(XGetPixel(_image, x, y)); }
+
+            for (int channel = 0; channel < 3; ++channel) {
+                wideRow[x * NUM_COLOR_CHANNELS + channel] = tables[channel][(pixel & masks[channel]) >> shifts[channel]];
+            }
+
+            wideRow[x * NUM_COLOR_CHANNELS + 3] = 0xFFFF;
+        }
+    }
+
+    if (scaling) {
+
+        // Bicubic and Lanczos have no deep colour kernels, bilinear stands in for them
+        const ScaleMethod method = _scaler.method;
+        if (!RowScaler::Supports(method)) { _scaler.method = ScaleMethod::Bilinear; }
+
+        const bool scaled = _scaler.Scale(widened, deepView);
+        _scaler.method = method;
+
+        if (!scaled) { return {}; }
+    }
+
+#else
+
+    // Only 8-bit captures are available here, stretch every byte to 16 bits
+    CaptureScreen();
+
+    const ConstImageView captured = View();
+    std::vector<MyByte> row(captured.resolution.width * BytesPerPixel(PixelFormat::BGRA32));
+
+    for (int y = 0; y < captured.resolution.height; ++y) {
+
+        ConvertRow(captured.Row(y), captured.format, row.data(), PixelFormat::BGRA32, captured.resolution.width);
+        Ushort* deepRow = reinterpret_cast<Ushort*>(deepView.Row(y));
+
+        for (size_t index = 0; index < row.size(); ++index) {
+            deepRow[index] = static_cast<Ubyte>(row[index]) * 257;
+        }
+    }
+
+#endif
+
+    return deepView;
+}
+
+#if defined(__linux__)
+
+bool ScreenCapture::CaptureRows(StreamingScaler& scaler) {
+
+    const Resolution& captureAreaRes = static_cast<Resolution>(_captureArea);
+    const int stripRows = std::min(CAPTURE_STRIP_ROWS, captureAreaRes.height);
+
+    const PixelFormat format = scaler.Format();
+    if (scaler.SourceResolution() != captureAreaRes || !CanConvert(PixelFormat::BGRA32, format)) { return false; }
+
+    // The strip holds BGRA, other formats are converted a row at a time
+    const bool converting = format != PixelFormat::BGRA32;
+    if (converting) { _convertedRow.resize(captureAreaRes.width * BytesPerPixel(format)); }
+
+    scaler.Reset();
+
+    XImage* strip = nullptr;
+
+    for (int top = 0; top < captureAreaRes.height; top += stripRows) {
+
+        const int rows = std::min(stripRows, captureAreaRes.height - top);
+
+        // Refill the same strip image for every strip after the first
+        if (strip == nullptr) {
+            strip = XGetImage(_display, _root, _captureArea.left, _captureArea.top,
+                captureAreaRes.width, stripRows, AllPlanes, ZPixmap);
+        }
+        else {
+            XGetSubImage(_display, _root, _captureArea.left, _captureArea.top + top,
+                captureAreaRes.width, rows, AllPlanes, ZPixmap, strip, 0, 0);
+        }
+
+        for (int row = 0; row < rows; ++row) {
+
+            const MyByte* stripRow = strip->data + row * strip->bytes_per_line;
+
+            if (converting) {
+                ConvertRow(stripRow, PixelFormat::BGRA32, _convertedRow.data(), format, captureAreaRes.width);
+                stripRow = _convertedRow.data();
+            }
+
+            scaler.PushRow(ConstPixel(stripRow, captureAreaRes.width * BytesPerPixel(format)));
+        }
+    }
+
+    if (strip != nullptr) { XDestroyImage(strip); }
+
+    return true;
 }
 
+#endif
+
 void ScreenCapture::SaveToFile(const PixelData& imageAndHeader, std::string filename) {
     // Add file extension if not present
     if (filename.find(".bmp") == std::string::npos) {
@@ -206,6 +498,227 @@ void ScreenCapture::SaveToFile(const PixelData& image, const Resolution& resolut
     SaveToFile(image, ConstructBMPHeader(resolution), filename);
 }
 
+// 8-bit bitmap of palette indices, each palette entry is 0x00RRGGBB
+static bool SaveIndexedBMP(const ConstImageView& indices, std::span<const Uint32> palette, const std::string& filename) {
+
+    const BmpFileHeader header = ConstructBMPHeader(indices.resolution, BITS_PER_CHANNEL, static_cast<Ushort>(palette.size()));
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    outputFile.write(header.data(), header.size());
+
+    for (const Uint32 color : palette) {
+        std::array<MyByte, BMP_PALETTE_ENTRY_SIZE> entry {};
+        EncodeAsByte(entry, color);
+        outputFile.write(entry.data(), entry.size());
+    }
+
+    // Rows are padded to a multiple of 4 bytes
+    const std::vector<MyByte> padding(CalculateBMPFileSize({ indices.resolution.width, 1 }, BITS_PER_CHANNEL) - indices.RowSize(), 0);
+
+    for (int y = 0; y < indices.resolution.height; ++y) {
+        outputFile.write(indices.Row(y), indices.RowSize());
+        outputFile.write(padding.data(), padding.size());
+    }
+
+    outputFile.close();
+    return outputFile.good();
+}
+
+bool ScreenCapture::SaveToFile(const ConstImageView& image, std::string filename) {
+    if (filename.find(".bmp") == std::string::npos) {
+        filename += ".bmp";
+    }
+
+    // Gray stays one byte a pixel, each value is its own palette entry
+    if (image.format == PixelFormat::Gray8) {
+
+        std::array<Uint32, 256> grays;
+        for (Uint32 value = 0; value < grays.size(); ++value) {
+            grays[value] = value << 16 | value << 8 | value;
+        }
+
+        return SaveIndexedBMP(image, grays, filename);
+    }
+
+    // Colour is stored as BGR when there is no alpha to keep, BGRA otherwise
+    const PixelFormat bmpFormat = ChannelCount(image.format) == 3 ? PixelFormat::BGR24 : PixelFormat::BGRA32;
+    if (!CanConvert(image.format, bmpFormat)) { return false; }
+
+    const Ushort bitsPerPixel = static_cast<Ushort>(BytesPerPixel(bmpFormat) * BITS_PER_CHANNEL);
+    const BmpFileHeader header = ConstructBMPHeader(image.resolution, bitsPerPixel);
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    outputFile.write(header.data(), header.size());
+
+    // Rows are padded to a multiple of 4 bytes
+    const size_t bmpRowSize = CalculateBMPFileSize({ image.resolution.width, 1 }, bitsPerPixel);
+
+    if (image.format == bmpFormat && image.IsPacked() && image.RowSize() == bmpRowSize) {
+        outputFile.write(image.data, image.PackedSize());
+        outputFile.close();
+        return outputFile.good();
+    }
+
+    // Skip the padding or the rest of the larger image between rows, converting one at a time
+    std::vector<char> bmpRow(bmpRowSize, 0);
+
+    for (int y = 0; y < image.resolution.height; ++y) {
+        ConvertRow(image.Row(y), image.format, bmpRow.data(), bmpFormat, image.resolution.width);
+        outputFile.write(bmpRow.data(), bmpRow.size());
+    }
+
+    outputFile.close();
+    return outputFile.good();
+}
+
+void ScreenCapture::SaveToFile(const IndexedImage& image, std::string filename) {
+    if (filename.find(".bmp") == std::string::npos) {
+        filename += ".bmp";
+    }
+
+    SaveIndexedBMP(image.indices, image.palette, filename);
+}
+
+void ScreenCapture::SaveRaw(const ConstImageView& image, const PixelFormat format, std::string filename) {
+
+    if (!CanConvert(image.format, format)) { return; }
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    std::vector<char> rawRow(image.resolution.width * BytesPerPixel(format));
+
+    for (int y = 0; y < image.resolution.height; ++y) {
+        ConvertRow(image.Row(y), image.format, rawRow.data(), format, image.resolution.width);
+        outputFile.write(rawRow.data(), rawRow.size());
+    }
+}
+
+void ScreenCapture::SaveToPam(const ConstImageView& image, std::string filename) {
+    if (filename.find(".pam") == std::string::npos) {
+        filename += ".pam";
+    }
+
+    const size_t sampleSize = BytesPerSample(image.format);
+    const size_t channels = ChannelCount(image.format);
+
+    const bool alpha = ChannelOrder(image.format)[3] >= 0;
+
+    std::string tupleType = alpha ? "RGB_ALPHA" : "RGB";
+    if (image.format == PixelFormat::Gray8) { tupleType = "GRAYSCALE"; }
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    outputFile << "P7\nWIDTH " << image.resolution.width << "\nHEIGHT " << image.resolution.height
+        << "\nDEPTH " << channels << "\nMAXVAL " << (sampleSize == 2 ? 65535 : 255)
+        << "\nTUPLTYPE " << tupleType << "\nENDHDR\n";
+
+    // PAM stores RGB order with big endian samples, gray as its single channel
+    std::vector<char> pamRow(image.resolution.width * channels * sampleSize);
+
+    // 8-bit colour only needs its channels reordered
+    PixelFormat pamFormat = alpha ? PixelFormat::RGBA32 : PixelFormat::RGB24;
+    if (image.format == PixelFormat::Gray8) { pamFormat = PixelFormat::Gray8; }
+    const bool reorder = sampleSize == 1 && CanConvert(image.format, pamFormat);
+
+    for (int y = 0; y < image.resolution.height; ++y) {
+
+        const MyByte* row = image.Row(y);
+
+        if (reorder) {
+            ConvertRow(row, image.format, pamRow.data(), pamFormat, image.resolution.width);
+            outputFile.write(pamRow.data(), pamRow.size());
+            continue;
+        }
+
+        for (int x = 0; x < image.resolution.width; ++x) {
+            for (size_t channel = 0; channel < channels; ++channel) {
+
+                // Swap blue and red, alpha and gray stay where they are
+                const size_t from = channel < 3 && channels >= 3 ? 2 - channel : channel;
+                const MyByte* sample = row + (x * channels + from) * sampleSize;
+                char* pamSample = pamRow.data() + (x * channels + channel) * sampleSize;
+
+                if (sampleSize == 2) {
+                    Ushort value;
+                    std::memcpy(&value, sample, sizeof(value));
+                    pamSample[0] = static_cast<char>(value >> 8);
+                    pamSample[1] = static_cast<char>(value & 0xFF);
+                }
+                else {
+                    pamSample[0] = sample[0];
+                }
+            }
+        }
+
+        outputFile.write(pamRow.data(), pamRow.size());
+    }
+}
+
+bool ScreenCapture::SaveToPng(const ConstImageView& image, std::string filename, const PngOptions& options) {
+    if (filename.find(".png") == std::string::npos) {
+        filename += ".png";
+    }
+
+    const PixelData png = EncodePng(image, options);
+    if (png.empty()) { return false; }
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    outputFile.write(png.data(), png.size());
+    outputFile.close();
+
+    return outputFile.good();
+}
+
+bool ScreenCapture::SaveToQoi(const ConstImageView& image, std::string filename, const QoiOptions& options) {
+    if (filename.find(".qoi") == std::string::npos) {
+        filename += ".qoi";
+    }
+
+    const PixelData qoi = EncodeQoi(image, options);
+    if (qoi.empty()) { return false; }
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    outputFile.write(qoi.data(), qoi.size());
+    outputFile.close();
+
+    return outputFile.good();
+}
+
+bool ScreenCapture::SaveToJpeg(const ConstImageView& image, std::string filename, const JpegOptions& options) {
+    if (filename.find(".jpg") == std::string::npos && filename.find(".jpeg") == std::string::npos) {
+        filename += ".jpg";
+    }
+
+    const PixelData jpeg = EncodeJpeg(image, options);
+    if (jpeg.empty()) { return false; }
+
+    std::ofstream outputFile(filename, std::ios::binary);
+    outputFile.write(jpeg.data(), jpeg.size());
+    outputFile.close();
+
+    return outputFile.good();
+}
+
+ImageBuffer ScreenCapture::LoadQoi(const std::string& filename) {
+
+    std::ifstream inputFile(filename, std::ios::binary);
+    const PixelData qoi((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
+
+    return DecodeQoi(qoi);
+}
+
+bool ScreenCapture::SaveToFile(const ConstImageView& image, const FileFormat format, std::string filename) {
+
+    switch (format) {
+    case FileFormat::PNG:
+        return SaveToPng(image, filename);
+    case FileFormat::QOI:
+        return SaveToQoi(image, filename);
+    case FileFormat::JPEG:
+        return SaveToJpeg(image, filename);
+    default:
+        return SaveToFile(image, filename);
+    }
+}
+
 void ScreenCapture::SaveToFile(const std::string& filename) const {
-    SaveToFile(_pixelData, _resolution, filename);
+    SaveToFile(_pixelData, _header, filename);
 }
\ No newline at end of file
@@ -1,6 +1,22 @@
 #pragma once
 
 #include "Scale.h"
+#include "Convert.h"
+#include "Quantize.h"
+#include "Png.h"
+#include "Qoi.h"
+#include "Jpeg.h"
+
+// Rows of the screen read at a time when streaming a capture
+constexpr const int CAPTURE_STRIP_ROWS = 32;
+
+// Formats SaveToFile can write an image in
+enum class FileFormat {
+    BMP,
+    PNG,
+    QOI,  // Lossless like PNG, several times faster to write for a larger file
+    JPEG  // Lossy, the smallest files for photos and video but blurs text
+};
 
 class ScreenCapture {
 
@@ -18,6 +34,52 @@ private:
     Uint32 _captureSize = 0;
     Uint32 _bitsPerPixel = 32;
 
+    // Writable view of _pixelData
+    ImageView PixelView();
+
+    // Statistics of every capture, gathered while its rows are written when turned on
+    bool _collectStats = false;
+    StatsCollector _statsCollector {};
+    FrameStats _stats {};
+
+    // The collector to hand a capture of format to, nullptr when statistics are off
+    StatsCollector* BeginStats(const PixelFormat format);
+    void EndStats();
+
+    // Capture into _pixelData
+    void Capture(StatsCollector* stats);
+
+    // Scales captures to _resolution
+    Scaler _scaler {};
+
+    // Deep colour ( BGRA64 ) captures at _resolution, only allocated once one is taken
+    PixelData _deepPixelData {};
+
+    // Captures converted out of BGRA32 for CaptureScreen(format)
+    PixelData _convertedPixelData {};
+
+#if defined(__linux__)
+
+    // The capture area widened to 16 bits a channel, when it still has to be scaled
+    PixelData _deepCapture {};
+
+    // The capture area converted out of BGRA, when it still has to be scaled
+    PixelData _convertedCapture {};
+
+    // Captures scaled as BGRA before being converted, for methods that can't scale other formats
+    PixelData _scaledCapture {};
+
+    // A streamed row converted out of BGRA for the scaler it is pushed to
+    PixelData _convertedRow {};
+
+    // Read the capture area from the screen into _image
+    void GrabImage();
+
+    // Capture into dest, scaled to its resolution and converted to its format
+    void CaptureInto(const ImageView& dest, StatsCollector* stats);
+
+#endif
+
 #if defined(_WIN32)
 
     HDC _srcHDC; // Device context of source
@@ -32,6 +94,9 @@ private:
 
 #if defined(__APPLE__)
 
+    // BGRA the context draws into when captures are 24 bits per pixel
+    PixelData _contextPixels {};
+
     CGColorSpace* _colorspace = nullptr;
     CGContext* _context = nullptr;
     CGImage* _image = nullptr;
@@ -73,12 +138,79 @@ public:
     void Crop(const ScreenArea& area);
     const PixelData& CaptureScreen();
 
+    // Capture straight into format, scaled to the resolution like CaptureScreen.
+    // Gray8 captures only luma, on Linux it is scaled as one channel too.
+    // The view is empty when BGRA can't be converted to format
+    ConstImageView CaptureScreen(const PixelFormat format);
+
+    // Capture at 16 bits a channel ( BGRA64 ), scaled to the resolution like CaptureScreen.
+    // 30-bit visuals keep all 10 bits of each channel, 8-bit ones are stretched to 16.
+    // Nearest neighbor, bilinear and area scale all 16 bits, Bicubic and Lanczos fall back to bilinear
+    ConstImageView CaptureScreenDeep();
+
+#if defined(__linux__)
+
+    // Capture the capture area a strip of rows at a time straight into scaler, without ever
+    // holding the whole screen. Rows are converted to the scaler's format on their way in.
+    // False, pushing nothing, when the scaler's source resolution isn't the capture area's size
+    // or BGRA can't be converted to its format
+    bool CaptureRows(StreamingScaler& scaler);
+
+#endif
+
     const PixelData WholeDeal() const;
     const Resolution& GetResolution() const;
 
+    // Scaler used when the capture area and resolution differ, change its method here
+    Scaler& GetScaler();
+
+    // 24 drops the alpha byte, which screens never fill in, making captures and bitmaps a quarter smaller.
+    // Captures are then BGR24 with rows padded to 4 bytes like a bitmap's. Only 24 and 32 are supported
+    void SetBitsPerPixel(const Ushort bitsPerPixel);
+    Ushort GetBitsPerPixel() const;
+
+    // View of the last capture
+    ConstImageView View() const;
+
+    // Gather FrameStats of every 8-bit capture as it is copied or scaled, for next to nothing over the capture itself.
+    // Histograms cost a good deal more, they are only counted when asked for
+    void CollectStats(const bool collect = true, const bool histograms = false);
+
+    // Statistics of the last capture, empty unless CollectStats is on
+    const FrameStats& Stats() const;
+
     static void SaveToFile(const PixelData& imageAndHeader, std::string filename = "screenshot.bmp");
     static void SaveToFile(const PixelData& image, const BmpFileHeader& header, std::string filename = "screenshot.bmp");
     static void SaveToFile(const PixelData& image, const Resolution& resolution, std::string filename = "screenshot.bmp");
+    // Gray8 views are saved as 8-bit bitmaps with a gray palette, 3 channel views as 24-bit, everything else as 32-bit.
+    // The savers of views return false when nothing could be encoded or the file wasn't written in full
+    static bool SaveToFile(const ConstImageView& image, std::string filename = "screenshot.bmp");
+
+    // 8-bit bitmap of the indices, with the image's palette. Quantize first to save colour captures a quarter the size
+    static void SaveToFile(const IndexedImage& image, std::string filename = "screenshot.bmp");
+
+    // Save only the pixels, packed and converted to format, for consumers that already know the size.
+    // Nothing is written when image can't be converted to format
+    static void SaveRaw(const ConstImageView& image, const PixelFormat format, std::string filename = "screenshot.raw");
+
+    // Save as a Netpbm PAM, the only output that keeps BGRA64's 16 bits a channel
+    static void SaveToPam(const ConstImageView& image, std::string filename = "screenshot.pam");
+
+    // Save as a compressed PNG, screen content usually ends up a tenth or less of the bitmap's size
+    static bool SaveToPng(const ConstImageView& image, std::string filename = "screenshot.png", const PngOptions& options = {});
+
+    // Save as QOI, lossless at close to the speed of copying the frame
+    static bool SaveToQoi(const ConstImageView& image, std::string filename = "screenshot.qoi", const QoiOptions& options = {});
+
+    // Save as a baseline JPEG, for frames where size matters more than exact pixels
+    static bool SaveToJpeg(const ConstImageView& image, std::string filename = "screenshot.jpg", const JpegOptions& options = {});
+
+    // BGRA32 image of a QOI file, empty when it can't be read
+    static ImageBuffer LoadQoi(const std::string& filename);
+
+    // Save in format, so each destination can pick its own. The format's extension is added when missing
+    static bool SaveToFile(const ConstImageView& image, const FileFormat format, std::string filename = "screenshot");
+
     void SaveToFile(const std::string& filename = "screenshot.bmp") const;
 };
 
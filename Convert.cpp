@@ -0,0 +1,667 @@
+#include "Convert.h"
+
+// Full range BT.601 luma in blue, green, red order, the weights grayscale conversions have always used
+constexpr const std::array<int, 3> GRAY_WEIGHTS { 1868, 9617, 4899 };
+
+/* ----- Weighted Sums ----- */
+
+#if defined(QUICKSHOT_SSE2)
+
+// Fixed point weights of the 4 samples of a pixel, repeated for the 2 pixels of 16 bit samples in a vector
+static __m128i WeightVector(const std::array<int, 4>& weights) {
+    return _mm_setr_epi16(weights[0], weights[1], weights[2], weights[3], weights[0], weights[1], weights[2], weights[3]);
+}
+
+// Weighted sum of each of the 4 pixels held in two vectors of 16 bit samples. pmaddwd weighs a pair of
+// channels at once, then the two halves of each pixel are added together
+static __m128i WeighPixels(const __m128i first, const __m128i second, const __m128i weights) {
+    const __m128i a = _mm_madd_epi16(first, weights);
+    const __m128i b = _mm_madd_epi16(second, weights);
+    return _mm_add_epi32(
+        _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0x88)),
+        _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0xDD)));
+}
+
+// 4 pixels of 3 channels, the first 12 bytes of pixels, spread out to 32 bits each. Bytes 0 to 7 and 6 to 13
+// go in the two halves, each starts with a pixel and shifting it up a byte lines its second pixel up with the
+// next 32 bits. The 4th byte of each pixel is left over from the pixel after it
+static __m128i SpreadPixels(const __m128i pixels) {
+    const __m128i evenPixels = _mm_setr_epi32(-1, 0, -1, 0);
+    const __m128i halves = _mm_unpacklo_epi64(pixels, _mm_srli_si128(pixels, 6));
+    return _mm_or_si128(_mm_and_si128(halves, evenPixels), _mm_andnot_si128(evenPixels, _mm_slli_epi64(halves, 8)));
+}
+
+// Luma of the 8 pixels in low and high, packed into the low 8 bytes. bias holds the offset and rounding
+static __m128i LumaBytes(const __m128i low, const __m128i high, const __m128i weights, const __m128i bias) {
+
+    const __m128i zero = _mm_setzero_si128();
+
+    const __m128i first = WeighPixels(_mm_unpacklo_epi8(low, zero), _mm_unpackhi_epi8(low, zero), weights);
+    const __m128i second = WeighPixels(_mm_unpacklo_epi8(high, zero), _mm_unpackhi_epi8(high, zero), weights);
+
+    const __m128i words = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(first, bias), YUV_WEIGHT_BITS),
+        _mm_srai_epi32(_mm_add_epi32(second, bias), YUV_WEIGHT_BITS));
+
+    return _mm_packus_epi16(words, words);
+}
+
+#endif
+
+/* ------------------------- */
+
+/* ----- Swizzle Kernels ----- */
+
+// pshufb control moving the 4 pixels held in a 16 byte lane from From's order to To's.
+// 3 channel pixels only fill the first 12 bytes of a lane, 0x80 zeroes a byte
+template <PixelFormat From, PixelFormat To>
+constexpr std::array<Ubyte, 16> ShuffleMask() {
+
+    constexpr int fromChannels = static_cast<int>(ChannelCount(From));
+    constexpr int toChannels = static_cast<int>(ChannelCount(To));
+    constexpr std::array<int, 4> fromOrder = ChannelOrder(From);
+    constexpr std::array<int, 4> toOrder = ChannelOrder(To);
+
+    std::array<Ubyte, 16> mask {};
+    mask.fill(0x80);
+
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        for (int channel = 0; channel < 4; ++channel) {
+            if (toOrder[channel] >= 0 && fromOrder[channel] >= 0) {
+                mask[pixel * toChannels + toOrder[channel]] = static_cast<Ubyte>(pixel * fromChannels + fromOrder[channel]);
+            }
+        }
+    }
+
+    return mask;
+}
+
+// Bytes of a lane set to opaque alpha because From has none to move
+template <PixelFormat From, PixelFormat To>
+constexpr std::array<Ubyte, 16> AlphaMask() {
+
+    constexpr int toChannels = static_cast<int>(ChannelCount(To));
+    constexpr bool fillAlpha = ChannelOrder(From)[3] < 0 && ChannelOrder(To)[3] >= 0;
+
+    std::array<Ubyte, 16> mask {};
+
+    for (int pixel = 0; fillAlpha && pixel < 4; ++pixel) {
+        mask[pixel * toChannels + ChannelOrder(To)[3]] = 0xFF;
+    }
+
+    return mask;
+}
+
+// Bytes of a 32 bit pixel that move up by each distance from -3 to 3 bytes going from From's order to To's
+template <PixelFormat From, PixelFormat To>
+constexpr std::array<Uint32, 7> MoveMasks() {
+
+    constexpr std::array<int, 4> fromOrder = ChannelOrder(From);
+    constexpr std::array<int, 4> toOrder = ChannelOrder(To);
+
+    std::array<Uint32, 7> masks {};
+
+    for (int channel = 0; channel < 4; ++channel) {
+        if (toOrder[channel] >= 0 && fromOrder[channel] >= 0) {
+            masks[toOrder[channel] - fromOrder[channel] + 3] |= 0xFFu << (toOrder[channel] * 8);
+        }
+    }
+
+    return masks;
+}
+
+// Bytes of 4 pixels of 3 channels that move up by each distance from -2 to 2 bytes going from From's order to To's
+template <PixelFormat From, PixelFormat To>
+constexpr std::array<std::array<Ubyte, 16>, 5> ByteMoveMasks() {
+
+    constexpr std::array<int, 4> fromOrder = ChannelOrder(From);
+    constexpr std::array<int, 4> toOrder = ChannelOrder(To);
+
+    std::array<std::array<Ubyte, 16>, 5> masks {};
+
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        for (int channel = 0; channel < 3; ++channel) {
+            masks[toOrder[channel] - fromOrder[channel] + 2][pixel * 3 + toOrder[channel]] = 0xFF;
+        }
+    }
+
+    return masks;
+}
+
+template <PixelFormat From, PixelFormat To>
+void SwizzleRow(const Ubyte* source, Ubyte* dest, const int width) {
+
+    constexpr int fromChannels = static_cast<int>(ChannelCount(From));
+    constexpr int toChannels = static_cast<int>(ChannelCount(To));
+    constexpr std::array<int, 4> fromOrder = ChannelOrder(From);
+    constexpr std::array<int, 4> toOrder = ChannelOrder(To);
+
+    // Vector loads and stores are always a full register wide, even though 3 channel rows
+    // only use 12 bytes of each lane. Stop before either would run off the end of the row
+    const auto fits = [&](const int x, const int bytes) {
+        return x * fromChannels + bytes <= width * fromChannels && x * toChannels + bytes <= width * toChannels;
+    };
+
+    int x = 0;
+
+#if defined(QUICKSHOT_SSSE3)
+
+    constexpr bool fillAlpha = fromOrder[3] < 0 && toOrder[3] >= 0;
+
+    static constexpr std::array<Ubyte, 16> shuffleBytes = ShuffleMask<From, To>();
+    static constexpr std::array<Ubyte, 16> alphaBytes = AlphaMask<From, To>();
+
+    const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleBytes.data()));
+    const __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphaBytes.data()));
+
+#if defined(QUICKSHOT_AVX2)
+
+    // pshufb never crosses a 128 bit lane, so 3 channel pixels are spread out to 12 bytes
+    // a lane before shuffling and packed back together after
+    const __m256i wideShuffle = _mm256_broadcastsi128_si256(shuffle);
+    const __m256i wideAlpha = _mm256_broadcastsi128_si256(alpha);
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    for (; fits(x, 32); x += 8) {
+
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x * fromChannels));
+
+        if constexpr (fromChannels == 3) { pixels = _mm256_permutevar8x32_epi32(pixels, spread); }
+
+        pixels = _mm256_shuffle_epi8(pixels, wideShuffle);
+
+        if constexpr (fillAlpha) { pixels = _mm256_or_si256(pixels, wideAlpha); }
+        if constexpr (toChannels == 3) { pixels = _mm256_permutevar8x32_epi32(pixels, pack); }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + x * toChannels), pixels);
+    }
+
+#endif
+
+    for (; fits(x, 16); x += 4) {
+
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * fromChannels));
+
+        pixels = _mm_shuffle_epi8(pixels, shuffle);
+
+        if constexpr (fillAlpha) { pixels = _mm_or_si128(pixels, alpha); }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x * toChannels), pixels);
+    }
+
+#elif defined(QUICKSHOT_SSE2)
+
+    // Without pshufb, channel orders are still a fixed permutation of each 32 bit pixel, built from
+    // one shift and mask per distance the channels move. 3 channel pixels are spread out to 32 bits first
+    constexpr bool fillAlpha = fromOrder[3] < 0 && toOrder[3] >= 0;
+
+    static constexpr std::array<Uint32, 7> moveMasks = MoveMasks<From, To>();
+    static constexpr std::array<Ubyte, 16> alphaBytes = AlphaMask<From, To>();
+
+    const __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphaBytes.data()));
+    const auto mask = [](const int distance) { return _mm_set1_epi32(static_cast<int>(moveMasks[distance + 3])); };
+    const __m128i evenPixels = _mm_setr_epi32(-1, 0, -1, 0);
+    const __m128i lowHalf = _mm_setr_epi32(-1, -1, 0, 0);
+
+    // Between 3 channel orders every byte of 4 pixels moves a fixed distance, so whole vectors shift instead
+    if constexpr (fromChannels == 3 && toChannels == 3) {
+
+        static constexpr std::array<std::array<Ubyte, 16>, 5> byteMasks = ByteMoveMasks<From, To>();
+        static constexpr std::array<Ubyte, 16> none {};
+
+        const auto byteMask = [](const int distance) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(byteMasks[distance + 2].data()));
+        };
+
+        for (; fits(x, 16); x += 4) {
+
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * fromChannels));
+
+            __m128i moved = _mm_and_si128(pixels, byteMask(0));
+            if constexpr (byteMasks[0] != none) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_srli_si128(pixels, 2), byteMask(-2))); }
+            if constexpr (byteMasks[1] != none) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_srli_si128(pixels, 1), byteMask(-1))); }
+            if constexpr (byteMasks[3] != none) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_slli_si128(pixels, 1), byteMask(1))); }
+            if constexpr (byteMasks[4] != none) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_slli_si128(pixels, 2), byteMask(2))); }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x * toChannels), moved);
+        }
+    }
+
+    for (; fits(x, 16); x += 4) {
+
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * fromChannels));
+
+        if constexpr (fromChannels == 3) { pixels = SpreadPixels(pixels); }
+
+        // Alpha isn't moved when there is nowhere for it to go
+        __m128i moved = _mm_and_si128(pixels, mask(0));
+        if constexpr (moveMasks[0] != 0) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_srli_epi32(pixels, 24), mask(-3))); }
+        if constexpr (moveMasks[1] != 0) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_srli_epi32(pixels, 16), mask(-2))); }
+        if constexpr (moveMasks[2] != 0) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_srli_epi32(pixels, 8), mask(-1))); }
+        if constexpr (moveMasks[4] != 0) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_slli_epi32(pixels, 8), mask(1))); }
+        if constexpr (moveMasks[5] != 0) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_slli_epi32(pixels, 16), mask(2))); }
+        if constexpr (moveMasks[6] != 0) { moved = _mm_or_si128(moved, _mm_and_si128(_mm_slli_epi32(pixels, 24), mask(3))); }
+
+        if constexpr (fillAlpha) { moved = _mm_or_si128(moved, alpha); }
+
+        // Close the gap left after each pixel, first within each pair of pixels then between the pairs
+        if constexpr (toChannels == 3) {
+            const __m128i pairs = _mm_or_si128(_mm_and_si128(moved, evenPixels),
+                _mm_srli_epi64(_mm_andnot_si128(evenPixels, moved), 8));
+            moved = _mm_or_si128(_mm_and_si128(pairs, lowHalf), _mm_srli_si128(_mm_andnot_si128(lowHalf, pairs), 2));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x * toChannels), moved);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+
+        const Ubyte* pixel = source + x * fromChannels;
+        Ubyte* converted = dest + x * toChannels;
+
+        for (int channel = 0; channel < 4; ++channel) {
+            if (toOrder[channel] >= 0) {
+                converted[toOrder[channel]] = fromOrder[channel] >= 0 ? pixel[fromOrder[channel]] : 0xFF;
+            }
+        }
+    }
+}
+
+// Luma of each pixel of From
+template <PixelFormat From>
+void GrayRow(const Ubyte* source, Ubyte* dest, const int width) {
+
+    constexpr int channels = static_cast<int>(ChannelCount(From));
+    constexpr std::array<int, 4> order = ChannelOrder(From);
+    constexpr int round = 1 << (YUV_WEIGHT_BITS - 1);
+
+    int x = 0;
+
+#if defined(QUICKSHOT_SSE2)
+
+    if constexpr (channels == 4) {
+
+        std::array<int, 4> weights {};
+        for (int channel = 0; channel < 3; ++channel) { weights[order[channel]] = GRAY_WEIGHTS[channel]; }
+
+        const __m128i weightVector = WeightVector(weights);
+        const __m128i bias = _mm_set1_epi32(round);
+
+        for (; x + 8 <= width; x += 8) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 4));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 4 + 16));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + x), LumaBytes(low, high, weightVector, bias));
+        }
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+        const Ubyte* pixel = source + x * channels;
+        dest[x] = static_cast<Ubyte>((GRAY_WEIGHTS[0] * pixel[order[0]] + GRAY_WEIGHTS[1] * pixel[order[1]] +
+            GRAY_WEIGHTS[2] * pixel[order[2]] + round) >> YUV_WEIGHT_BITS);
+    }
+}
+
+// Gray copied into every colour channel of To, alpha opaque
+template <PixelFormat To>
+void ExpandGrayRow(const Ubyte* source, Ubyte* dest, const int width) {
+
+    constexpr int channels = static_cast<int>(ChannelCount(To));
+    constexpr std::array<int, 4> order = ChannelOrder(To);
+
+    int x = 0;
+
+#if defined(QUICKSHOT_SSE2)
+
+    if constexpr (channels == 4) {
+
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFFu << (order[3] * 8)));
+
+        // Doubling each byte twice spreads 4 gray values over 4 whole pixels
+        for (; x + 16 <= width; x += 16) {
+
+            const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+            const __m128i low = _mm_unpacklo_epi8(gray, gray);
+            const __m128i high = _mm_unpackhi_epi8(gray, gray);
+
+            __m128i* pixels = reinterpret_cast<__m128i*>(dest + x * 4);
+            _mm_storeu_si128(pixels, _mm_or_si128(_mm_unpacklo_epi16(low, low), alpha));
+            _mm_storeu_si128(pixels + 1, _mm_or_si128(_mm_unpackhi_epi16(low, low), alpha));
+            _mm_storeu_si128(pixels + 2, _mm_or_si128(_mm_unpacklo_epi16(high, high), alpha));
+            _mm_storeu_si128(pixels + 3, _mm_or_si128(_mm_unpackhi_epi16(high, high), alpha));
+        }
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+
+        Ubyte* pixel = dest + x * channels;
+
+        for (int channel = 0; channel < 3; ++channel) { pixel[order[channel]] = source[x]; }
+        if constexpr (channels == 4) { pixel[order[3]] = 0xFF; }
+    }
+}
+
+/* --------------------------- */
+
+/* ----- Format Conversion ----- */
+
+template <PixelFormat From>
+RowConverter ConverterFrom(const PixelFormat to) {
+
+    switch (to) {
+    case PixelFormat::BGRA32:
+        return SwizzleRow<From, PixelFormat::BGRA32>;
+    case PixelFormat::RGBA32:
+        return SwizzleRow<From, PixelFormat::RGBA32>;
+    case PixelFormat::ARGB32:
+        return SwizzleRow<From, PixelFormat::ARGB32>;
+    case PixelFormat::BGR24:
+        return SwizzleRow<From, PixelFormat::BGR24>;
+    case PixelFormat::RGB24:
+        return SwizzleRow<From, PixelFormat::RGB24>;
+    case PixelFormat::Gray8:
+        return GrayRow<From>;
+    default:
+        return nullptr;
+    }
+}
+
+RowConverter ConverterFromGray(const PixelFormat to) {
+
+    switch (to) {
+    case PixelFormat::BGRA32:
+        return ExpandGrayRow<PixelFormat::BGRA32>;
+    case PixelFormat::RGBA32:
+        return ExpandGrayRow<PixelFormat::RGBA32>;
+    case PixelFormat::ARGB32:
+        return ExpandGrayRow<PixelFormat::ARGB32>;
+    case PixelFormat::BGR24:
+        return ExpandGrayRow<PixelFormat::BGR24>;
+    case PixelFormat::RGB24:
+        return ExpandGrayRow<PixelFormat::RGB24>;
+    default:
+        return nullptr;
+    }
+}
+
+RowConverter ConverterFor(const PixelFormat from, const PixelFormat to) {
+
+    switch (from) {
+    case PixelFormat::BGRA32:
+        return ConverterFrom<PixelFormat::BGRA32>(to);
+    case PixelFormat::RGBA32:
+        return ConverterFrom<PixelFormat::RGBA32>(to);
+    case PixelFormat::ARGB32:
+        return ConverterFrom<PixelFormat::ARGB32>(to);
+    case PixelFormat::BGR24:
+        return ConverterFrom<PixelFormat::BGR24>(to);
+    case PixelFormat::RGB24:
+        return ConverterFrom<PixelFormat::RGB24>(to);
+    case PixelFormat::Gray8:
+        return ConverterFromGray(to);
+    default:
+        return nullptr;
+    }
+}
+
+bool CanConvert(const PixelFormat from, const PixelFormat to) {
+    return from == to || ConverterFor(from, to) != nullptr;
+}
+
+void ConvertRow(const MyByte* source, const PixelFormat from, MyByte* dest, const PixelFormat to, const int width) {
+
+    if (from == to) {
+        std::memcpy(dest, source, width * BytesPerPixel(from));
+        return;
+    }
+
+    if (const RowConverter converter = ConverterFor(from, to)) {
+        converter(reinterpret_cast<const Ubyte*>(source), reinterpret_cast<Ubyte*>(dest), width);
+    }
+}
+
+bool Convert(const ConstImageView& source, const ImageView& dest, StatsCollector* stats) {
+
+    if (source.resolution != dest.resolution || !CanConvert(source.format, dest.format)) { return false; }
+
+    // Matching formats are a plain copy
+    const RowConverter converter = source.format == dest.format ? nullptr : ConverterFor(source.format, dest.format);
+
+    for (int y = 0; y < source.resolution.height; ++y) {
+
+        if (converter == nullptr) {
+            std::memcpy(dest.Row(y), source.Row(y), source.RowSize());
+        }
+        else {
+            converter(reinterpret_cast<const Ubyte*>(source.Row(y)), reinterpret_cast<Ubyte*>(dest.Row(y)), source.resolution.width);
+        }
+
+        if (stats != nullptr) { stats->AddRow(dest.Row(y), dest.resolution.width); }
+    }
+
+    return true;
+}
+
+ImageBuffer Convert(const ConstImageView& source, const PixelFormat format) {
+
+    if (!CanConvert(source.format, format)) { return ImageBuffer(); }
+
+    ImageBuffer converted(source.resolution, format);
+    Convert(source, converted.View());
+
+    return converted;
+}
+
+/* ----------------------------- */
+
+/* ----- YUV Conversion ----- */
+
+// Chroma comes from the sum of 4 pixels, so it has 2 more fraction bits to drop
+constexpr const int YUV_CHROMA_SHIFT = YUV_WEIGHT_BITS + 2;
+constexpr const int YUV_CHROMA_ROUND = (128 << YUV_CHROMA_SHIFT) + (1 << (YUV_CHROMA_SHIFT - 1));
+
+YuvWeights WeightsFor(const YuvConversion& conversion, const PixelFormat format) {
+
+    // Share of red and blue in luma, green makes up the rest
+    const double red = conversion.matrix == YuvMatrix::BT709 ? 0.2126 : 0.299;
+    const double blue = conversion.matrix == YuvMatrix::BT709 ? 0.0722 : 0.114;
+
+    const bool limited = conversion.range == YuvRange::Limited;
+    const double lumaScale = limited ? 219 / 255.0 : 1;
+    const double chromaScale = limited ? 224 / 255.0 : 1;
+
+    const auto fixed = [](const double weight) { return static_cast<int>(std::lround(weight * (1 << YUV_WEIGHT_BITS))); };
+
+    // Blue, green and red. Green is whatever makes white land on the top of the luma range and grey have no chroma
+    std::array<int, 3> y { fixed(blue * lumaScale), 0, fixed(red * lumaScale) };
+    std::array<int, 3> u { fixed(0.5 * chromaScale), 0, fixed(-red / (2 * (1 - blue)) * chromaScale) };
+    std::array<int, 3> v { fixed(-blue / (2 * (1 - red)) * chromaScale), 0, fixed(0.5 * chromaScale) };
+
+    y[1] = fixed(lumaScale) - y[0] - y[2];
+    u[1] = -u[0] - u[2];
+    v[1] = -v[0] - v[2];
+
+    YuvWeights weights;
+    weights.lumaOffset = limited ? 16 : 0;
+
+    const std::array<int, 4> order = ChannelOrder(format);
+    for (int channel = 0; channel < 3; ++channel) {
+        weights.y[order[channel]] = y[channel];
+        weights.u[order[channel]] = u[channel];
+        weights.v[order[channel]] = v[channel];
+    }
+
+    return weights;
+}
+
+#if defined(QUICKSHOT_SSE2)
+
+// ToYuvRows 8 pixels of both rows at a time, samples are widened to 16 bits for pmaddwd. 3 channel pixels
+// are spread out to 32 bits first, their 4th byte has no weight. Returns the first column left over
+template <int Channels>
+static int ToYuvBlocks(const Ubyte* top, const Ubyte* bottom, const int width, const YuvWeights& weights,
+    Ubyte* lumaTop, Ubyte* lumaBottom, Ubyte* u, Ubyte* v, const int chromaStep, const int lumaRound) {
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i yWeights = WeightVector(weights.y);
+    const __m128i uWeights = WeightVector(weights.u);
+    const __m128i vWeights = WeightVector(weights.v);
+    const __m128i lumaBias = _mm_set1_epi32(lumaRound);
+    const __m128i chromaBias = _mm_set1_epi32(YUV_CHROMA_ROUND);
+    const bool interleaved = chromaStep == 2 && v == u + 1;
+
+    const auto luma = [&](const __m128i low, const __m128i high, Ubyte* lumaRow) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(lumaRow), LumaBytes(low, high, yWeights, lumaBias));
+    };
+
+    // 4 pixels of a row as 32 bits each
+    const auto load = [](const Ubyte* row, const int x) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * Channels));
+        if constexpr (Channels == 3) { return SpreadPixels(pixels); }
+        return pixels;
+    };
+
+    int x = 0;
+
+    // 3 channel loads read 4 bytes past the 4 pixels they use
+    for (; x * Channels + (Channels == 3 ? 28 : 32) <= width * Channels; x += 8) {
+
+        const __m128i topLow = load(top, x);
+        const __m128i topHigh = load(top, x + 4);
+        const __m128i bottomLow = load(bottom, x);
+        const __m128i bottomHigh = load(bottom, x + 4);
+
+        luma(topLow, topHigh, lumaTop + x);
+        if (lumaBottom != nullptr) { luma(bottomLow, bottomHigh, lumaBottom + x); }
+
+        // Add the rows, then each pair of neighbouring pixels, leaving 4 blocks of 16 bit sums
+        const __m128i sums0 = _mm_add_epi16(_mm_unpacklo_epi8(topLow, zero), _mm_unpacklo_epi8(bottomLow, zero));
+        const __m128i sums1 = _mm_add_epi16(_mm_unpackhi_epi8(topLow, zero), _mm_unpackhi_epi8(bottomLow, zero));
+        const __m128i sums2 = _mm_add_epi16(_mm_unpacklo_epi8(topHigh, zero), _mm_unpacklo_epi8(bottomHigh, zero));
+        const __m128i sums3 = _mm_add_epi16(_mm_unpackhi_epi8(topHigh, zero), _mm_unpackhi_epi8(bottomHigh, zero));
+
+        const __m128i blocks01 = _mm_add_epi16(_mm_unpacklo_epi64(sums0, sums1), _mm_unpackhi_epi64(sums0, sums1));
+        const __m128i blocks23 = _mm_add_epi16(_mm_unpacklo_epi64(sums2, sums3), _mm_unpackhi_epi64(sums2, sums3));
+
+        // The 2x2 blocks are laid out like single pixels, just summed
+        const auto chroma = [&](const __m128i weights) {
+            const __m128i sums = WeighPixels(blocks01, blocks23, weights);
+            return _mm_srai_epi32(_mm_add_epi32(sums, chromaBias), YUV_CHROMA_SHIFT);
+        };
+
+        // U in the low 4 bytes, V in the next 4
+        const __m128i words = _mm_packs_epi32(chroma(uWeights), chroma(vWeights));
+        const __m128i bytes = _mm_packus_epi16(words, words);
+
+        const int chromaX = x / 2;
+
+        if (interleaved) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(u + chromaX * 2), _mm_unpacklo_epi8(bytes, _mm_srli_si128(bytes, 4)));
+            continue;
+        }
+
+        if (chromaStep == 1) {
+            const int uBytes = _mm_cvtsi128_si32(bytes);
+            const int vBytes = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+            std::memcpy(u + chromaX, &uBytes, sizeof(uBytes));
+            std::memcpy(v + chromaX, &vBytes, sizeof(vBytes));
+            continue;
+        }
+
+        alignas(16) Ubyte chromaBytes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(chromaBytes), bytes);
+        for (int sample = 0; sample < 4; ++sample) {
+            u[(chromaX + sample) * chromaStep] = chromaBytes[sample];
+            v[(chromaX + sample) * chromaStep] = chromaBytes[sample + 4];
+        }
+    }
+
+    return x;
+}
+
+#endif
+
+void ToYuvRows(const Ubyte* top, const Ubyte* bottom, const PixelFormat format, const int width,
+    const YuvWeights& weights, Ubyte* lumaTop, Ubyte* lumaBottom, Ubyte* u, Ubyte* v, const int chromaStep) {
+
+    const int channels = static_cast<int>(ChannelCount(format));
+
+    const int lumaRound = (weights.lumaOffset << YUV_WEIGHT_BITS) + (1 << (YUV_WEIGHT_BITS - 1));
+
+    int x = 0;
+
+#if defined(QUICKSHOT_SSE2)
+
+    if (channels == 4) { x = ToYuvBlocks<4>(top, bottom, width, weights, lumaTop, lumaBottom, u, v, chromaStep, lumaRound); }
+    if (channels == 3) { x = ToYuvBlocks<3>(top, bottom, width, weights, lumaTop, lumaBottom, u, v, chromaStep, lumaRound); }
+
+#endif
+
+    const auto weigh = [&](const std::array<int, 4>& w, const Ubyte* pixel) {
+        int sum = 0;
+        for (int channel = 0; channel < channels; ++channel) { sum += w[channel] * pixel[channel]; }
+        return sum;
+    };
+
+    for (; x < width; x += 2) {
+
+        // The last column of an odd width stands in for its missing neighbour
+        const int right = std::min(x + 1, width - 1);
+
+        for (int column = x; column <= right; ++column) {
+            lumaTop[column] = static_cast<Ubyte>((weigh(weights.y, top + column * channels) + lumaRound) >> YUV_WEIGHT_BITS);
+            if (lumaBottom != nullptr) {
+                lumaBottom[column] = static_cast<Ubyte>((weigh(weights.y, bottom + column * channels) + lumaRound) >> YUV_WEIGHT_BITS);
+            }
+        }
+
+        std::array<int, 4> block {};
+        for (const Ubyte* pixel : { top + x * channels, top + right * channels, bottom + x * channels, bottom + right * channels }) {
+            for (int channel = 0; channel < channels; ++channel) { block[channel] += pixel[channel]; }
+        }
+
+        const auto chroma = [&](const std::array<int, 4>& w) {
+            int sum = YUV_CHROMA_ROUND;
+            for (int channel = 0; channel < channels; ++channel) { sum += w[channel] * block[channel]; }
+            return static_cast<Ubyte>(std::clamp(sum >> YUV_CHROMA_SHIFT, 0, 255));
+        };
+
+        u[(x / 2) * chromaStep] = chroma(weights.u);
+        v[(x / 2) * chromaStep] = chroma(weights.v);
+    }
+}
+
+bool ToYuv(const ConstImageView& source, YuvFrame& frame, const YuvConversion& conversion) {
+
+    const Resolution& resolution = source.resolution;
+
+    if (resolution != frame.GetResolution() || BytesPerSample(source.format) != 1 || ChannelCount(source.format) < 3) {
+        return false;
+    }
+
+    const YuvWeights weights = WeightsFor(conversion, source.format);
+
+    for (int y = 0; y < resolution.height; y += 2) {
+
+        // The last row of an odd height is its own pair
+        const bool pair = y + 1 < resolution.height;
+        const size_t chromaOffset = (y / 2) * frame.ChromaStride();
+
+        ToYuvRows(reinterpret_cast<const Ubyte*>(source.Row(y)), reinterpret_cast<const Ubyte*>(source.Row(pair ? y + 1 : y)),
+            source.format, resolution.width, weights,
+            reinterpret_cast<Ubyte*>(frame.Luma() + y * resolution.width),
+            pair ? reinterpret_cast<Ubyte*>(frame.Luma() + (y + 1) * resolution.width) : nullptr,
+            reinterpret_cast<Ubyte*>(frame.ChromaU() + chromaOffset), reinterpret_cast<Ubyte*>(frame.ChromaV() + chromaOffset),
+            frame.ChromaStep());
+    }
+
+    return true;
+}
+
+/* -------------------------- */
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Stats.h"
+
+/*----------Format Conversion----------*/
+
+// Converts width pixels of one row, the rows must not overlap
+using RowConverter = void (*)(const Ubyte* source, Ubyte* dest, const int width);
+
+// Kernel reordering the channels of from into to, nullptr unless both are 8-bit formats.
+// Missing alpha is filled in opaque, alpha with nowhere to go is dropped. Colour becomes
+// Gray8 as full range BT.601 luma, gray is copied into every colour channel
+RowConverter ConverterFor(const PixelFormat from, const PixelFormat to);
+
+// Whether pixels of from can be converted to to, every format converts to itself
+bool CanConvert(const PixelFormat from, const PixelFormat to);
+
+// Convert one row of width pixels, nothing happens when the formats can't be converted
+void ConvertRow(const MyByte* source, const PixelFormat from, MyByte* dest, const PixelFormat to, const int width);
+
+// Convert source into dest, which must be the same resolution. False when it isn't or the formats can't be converted.
+// stats, when given, collects each converted row right after it is written
+bool Convert(const ConstImageView& source, const ImageView& dest, StatsCollector* stats = nullptr);
+
+// Copy of source in format, empty when the formats can't be converted
+ImageBuffer Convert(const ConstImageView& source, const PixelFormat format);
+
+/*-------------------------------------*/
+
+/*----------YUV Conversion----------*/
+
+enum class YuvMatrix {
+    BT601,  // Standard definition
+    BT709   // High definition
+};
+
+enum class YuvRange {
+    Limited,  // Luma 16 - 235, chroma 16 - 240, what most encoders expect
+    Full      // Every value 0 - 255
+};
+
+struct YuvConversion {
+    YuvMatrix matrix = YuvMatrix::BT709;
+    YuvRange range = YuvRange::Limited;
+};
+
+// Fraction bits of the fixed point YUV weights
+constexpr const int YUV_WEIGHT_BITS = 14;
+
+// Fixed point weight of each sample of a pixel in Y, U and V, laid out in the pixel's own channel order
+struct YuvWeights {
+    std::array<int, 4> y {};
+    std::array<int, 4> u {};
+    std::array<int, 4> v {};
+    int lumaOffset = 0;
+};
+
+YuvWeights WeightsFor(const YuvConversion& conversion, const PixelFormat format);
+
+// Convert two rows of 8-bit colour pixels into two luma rows and the chroma row they share.
+// For the last row of an odd height pass bottom as top and lumaBottom as nullptr.
+// Chroma is the average of each 2x2 block, chromaStep is the distance between U ( or V ) samples
+void ToYuvRows(const Ubyte* top, const Ubyte* bottom, const PixelFormat format, const int width,
+    const YuvWeights& weights, Ubyte* lumaTop, Ubyte* lumaBottom, Ubyte* u, Ubyte* v, const int chromaStep);
+
+// Convert source into frame, which must be the same resolution. False when it isn't or source isn't 8-bit colour
+bool ToYuv(const ConstImageView& source, YuvFrame& frame, const YuvConversion& conversion = {});
+
+/*----------------------------------*/
@@ -19,11 +19,11 @@ const std::string percentageOfScreenCaptured(const Resolution& nativeRes, const
     return formatted.str();
 }
 
-const std::string NameImage(const Resolution& resolution, const bool isOriginal = false) {
+const std::string NameImage(const Resolution& resolution, const Scaler::ScaleMethod method, const bool isOriginal = false) {
 
 	std::string imageName;
 
-	switch (Scaler::method) {
+	switch (method) {
 	case Scaler::ScaleMethod::NearestNeighbor:
 		imageName = "NearestNeighbor";
 		break;
@@ -33,6 +33,9 @@ const std::string NameImage(const Resolution& resolution, const bool isOriginal
 	case Scaler::ScaleMethod::Bicubic:
 		imageName = "Bicubic";
 		break;
+	case Scaler::ScaleMethod::Area:
+		imageName = "Area";
+		break;
 	default:
 		 imageName = "Unknown";
 	}
@@ -53,23 +56,26 @@ int main(int argc, char** argv) {
 	ScreenCapture screen(sourceRes);
 
 	PixelData image = screen.CaptureScreen();
-	screen.SaveToFile(NameImage(screen.GetResolution(), true));
+	screen.SaveToFile(NameImage(screen.GetResolution(), screen.GetScaler().method, true));
+
+	// Gray captures keep one channel in PAM
+	ScreenCapture::SaveToPam(screen.CaptureScreen(PixelFormat::Gray8), "Gray" + NameImage(screen.GetResolution(), screen.GetScaler().method, true));
 
-	//Scaler::method = Scaler::ScaleMethod::NearestNeighbor;
-	//PixelData scaled = Scaler::Scale(image, sourceRes, targetRes);
-	//screen.SaveToFile(scaled, targetRes, NameImage(targetRes));
+	//Scaler nearest(Scaler::ScaleMethod::NearestNeighbor);
+	//PixelData scaled = nearest.Scale(image, sourceRes, targetRes);
+	//screen.SaveToFile(scaled, targetRes, NameImage(targetRes, nearest.method));
 
-	//Scaler::method = Scaler::ScaleMethod::Bilinear;
-	//scaled = Scaler::Scale(image, sourceRes, targetRes);
-	//screen.SaveToFile(scaled, targetRes, NameImage(targetRes));
-	Scaler::method = Scaler::ScaleMethod::Bicubic;
+	//Scaler bilinear(Scaler::ScaleMethod::Bilinear);
+	//scaled = bilinear.Scale(image, sourceRes, targetRes);
+	//screen.SaveToFile(scaled, targetRes, NameImage(targetRes, bilinear.method));
+	Scaler scaler(Scaler::ScaleMethod::Bicubic);
 	auto begin = std::chrono::high_resolution_clock::now();
-	auto scaled = Scaler::Scale(image, sourceRes, targetRes);
+	auto scaled = scaler.Scale(image, sourceRes, targetRes);
 	auto end = std::chrono::high_resolution_clock::now();
 
 	std::cout << std::chrono::duration_cast<std::chrono::seconds>(end - begin).count() << std::endl;
 
-	screen.SaveToFile(scaled, targetRes, NameImage(targetRes));
+	screen.SaveToFile(scaled, targetRes, NameImage(targetRes, scaler.method));
 
 
     return 0;
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "TypesAndDefs.h"
+
+// Layout of the bytes of one pixel
+enum class PixelFormat {
+    BGRA32,
+    BGR24,   // No alpha, rows hold 3 bytes a pixel
+    Gray8,   // One luminance byte a pixel
+    BGRA64,  // Deep colour, 16 bits a channel in native byte order
+    RGBA32,
+    RGB24,
+    ARGB32   // Alpha leads, the order big endian consumers read a 32-bit pixel in
+};
+
+// Bytes one pixel of format takes
+constexpr size_t BytesPerPixel(const PixelFormat format) {
+    switch (format) {
+    case PixelFormat::BGRA32:
+    case PixelFormat::RGBA32:
+    case PixelFormat::ARGB32:
+        return 4;
+    case PixelFormat::BGR24:
+    case PixelFormat::RGB24:
+        return 3;
+    case PixelFormat::Gray8:
+        return 1;
+    case PixelFormat::BGRA64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// Bytes each channel of format takes
+constexpr size_t BytesPerSample(const PixelFormat format) {
+    return format == PixelFormat::BGRA64 ? 2 : 1;
+}
+
+// Channels in one pixel of format
+constexpr size_t ChannelCount(const PixelFormat format) {
+    return BytesPerPixel(format) / BytesPerSample(format);
+}
+
+
+// Sample of a pixel holding blue, green, red and alpha, -1 when format has no alpha.
+// Gray8 answers 0 for every colour
+constexpr std::array<int, 4> ChannelOrder(const PixelFormat format) {
+    switch (format) {
+    case PixelFormat::BGR24:
+        return { 0, 1, 2, -1 };
+    case PixelFormat::Gray8:
+        return { 0, 0, 0, -1 };
+    case PixelFormat::RGBA32:
+        return { 2, 1, 0, 3 };
+    case PixelFormat::RGB24:
+        return { 2, 1, 0, -1 };
+    case PixelFormat::ARGB32:
+        return { 3, 2, 1, 0 };
+    default:
+        return { 0, 1, 2, 3 };
+    }
+}
+
+// Whether one channel of format is alpha rather than colour, ChannelOrder says which
+constexpr bool HasAlpha(const PixelFormat format) {
+    return ChannelOrder(format)[3] >= 0;
+}
+
+// Non-owning window onto pixels, rows may be padded or belong to a larger image
+template <typename Byte>
+struct BasicImageView {
+    Byte* data = nullptr;
+    Resolution resolution { 0, 0 };
+    size_t stride = 0;   // Bytes from the start of one row to the start of the next
+    PixelFormat format = PixelFormat::BGRA32;
+
+    constexpr BasicImageView() = default;
+    constexpr BasicImageView(Byte* data, const Resolution& resolution, const size_t stride,
+        const PixelFormat format = PixelFormat::BGRA32) :
+        data(data), resolution(resolution), stride(stride), format(format) {}
+
+    // Tightly packed rows
+    constexpr BasicImageView(Byte* data, const Resolution& resolution, const PixelFormat format = PixelFormat::BGRA32) :
+        BasicImageView(data, resolution, resolution.width * BytesPerPixel(format), format) {}
+
+    // A mutable view can always be used as a const one
+    template <typename OtherByte>
+        requires std::is_convertible_v<OtherByte*, Byte*>
+    constexpr BasicImageView(const BasicImageView<OtherByte>& other) :
+        BasicImageView(other.data, other.resolution, other.stride, other.format) {}
+
+    // Bytes of actual pixels in a row, without padding
+    constexpr size_t RowSize() const { return resolution.width * BytesPerPixel(format); }
+
+    // Bytes needed to hold the view tightly packed
+    constexpr size_t PackedSize() const { return RowSize() * resolution.height; }
+
+    constexpr bool IsPacked() const { return stride == RowSize(); }
+
+    constexpr Byte* Row(const int y) const { return data + y * stride; }
+
+    // View of part of this image, nothing is copied
+    constexpr BasicImageView Crop(const ScreenArea& area) const {
+        const Resolution cropped { area.right - area.left, area.bottom - area.top };
+        return { Row(area.top) + area.left * BytesPerPixel(format), cropped, stride, format };
+    }
+};
+
+using ImageView = BasicImageView<MyByte>;
+using ConstImageView = BasicImageView<const MyByte>;
+
+// Image that owns its tightly packed pixels
+class ImageBuffer {
+
+private:
+
+    PixelData _pixels {};
+    Resolution _resolution { 0, 0 };
+    PixelFormat _format = PixelFormat::BGRA32;
+
+public:
+
+    ImageBuffer() = default;
+
+    ImageBuffer(const Resolution& resolution, const PixelFormat format = PixelFormat::BGRA32) :
+        _pixels(resolution.width * BytesPerPixel(format) * resolution.height), _resolution(resolution), _format(format) {}
+
+    ImageBuffer(PixelData&& pixels, const Resolution& resolution, const PixelFormat format = PixelFormat::BGRA32) :
+        _pixels(std::move(pixels)), _resolution(resolution), _format(format) {}
+
+    // Copy the pixels a view refers to
+    explicit ImageBuffer(const ConstImageView& view) : ImageBuffer(view.resolution, view.format) {
+        for (int y = 0; y < view.resolution.height; ++y) {
+            std::copy_n(view.Row(y), view.RowSize(), _pixels.data() + y * view.RowSize());
+        }
+    }
+
+    ImageView View() { return { _pixels.data(), _resolution, _format }; }
+    ConstImageView View() const { return { _pixels.data(), _resolution, _format }; }
+
+    operator ImageView() { return View(); }
+    operator ConstImageView() const { return View(); }
+
+    const Resolution& GetResolution() const { return _resolution; }
+    PixelFormat Format() const { return _format; }
+
+    const PixelData& Pixels() const { return _pixels; }
+
+    // Give up ownership of the pixels, leaving the buffer empty
+    PixelData Release() { _resolution = { 0, 0 }; return std::move(_pixels); }
+};
+
+// Plane layouts of 4:2:0 video frames, chroma is half the luma's width and height rounded up
+enum class YuvLayout {
+    I420,   // Y plane, then U plane, then V plane
+    NV12    // Y plane, then one plane of interleaved U and V
+};
+
+// 4:2:0 frame that owns its planes, back to back and tightly packed
+class YuvFrame {
+
+private:
+
+    PixelData _pixels {};
+    Resolution _resolution { 0, 0 };
+    YuvLayout _layout = YuvLayout::I420;
+
+public:
+
+    YuvFrame() = default;
+
+    YuvFrame(const Resolution& resolution, const YuvLayout layout = YuvLayout::I420) :
+        _resolution(resolution), _layout(layout) {
+        const Resolution chroma = ChromaResolution();
+        _pixels.resize(LumaSize() + 2 * chroma.width * chroma.height);
+    }
+
+    const Resolution& GetResolution() const { return _resolution; }
+    YuvLayout Layout() const { return _layout; }
+
+    Resolution ChromaResolution() const { return { (_resolution.width + 1) / 2, (_resolution.height + 1) / 2 }; }
+
+    size_t LumaSize() const { return _resolution.width * _resolution.height; }
+
+    // Bytes from one chroma row to the next, and from one U ( or V ) sample to the next
+    size_t ChromaStride() const { return ChromaResolution().width * ChromaStep(); }
+    int ChromaStep() const { return _layout == YuvLayout::NV12 ? 2 : 1; }
+
+    MyByte* Luma() { return _pixels.data(); }
+    MyByte* ChromaU() { return _pixels.data() + LumaSize(); }
+    MyByte* ChromaV() {
+        const Resolution chroma = ChromaResolution();
+        return _layout == YuvLayout::NV12 ? ChromaU() + 1 : ChromaU() + chroma.width * chroma.height;
+    }
+
+    const PixelData& Pixels() const { return _pixels; }
+
+    // Give up ownership of the planes, leaving the frame empty
+    PixelData Release() { _resolution = { 0, 0 }; return std::move(_pixels); }
+};
@@ -0,0 +1,598 @@
+#include "Jpeg.h"
+#include "Convert.h"
+#include "Parallel.h"
+
+constexpr const int JPEG_BLOCK_SIZE = 8;
+constexpr const int JPEG_BLOCK_AREA = JPEG_BLOCK_SIZE * JPEG_BLOCK_SIZE;
+constexpr const int JPEG_MAX_SIDE = 65535;
+
+// Fraction bits of the DCT's constants, as in libjpeg's fast integer DCT
+constexpr const int DCT_CONST_BITS = 8;
+
+enum JpegMarker : Ubyte {
+    JPEG_SOI = 0xD8,
+    JPEG_EOI = 0xD9,
+    JPEG_APP0 = 0xE0,
+    JPEG_DQT = 0xDB,
+    JPEG_SOF0 = 0xC0,
+    JPEG_DHT = 0xC4,
+    JPEG_DRI = 0xDD,
+    JPEG_SOS = 0xDA,
+    JPEG_RST0 = 0xD0
+};
+
+/* ----- Tables ----- */
+
+// Natural index of each coefficient in zigzag order
+constexpr std::array<int, JPEG_BLOCK_AREA> ZIGZAG { 0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37,
+    44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+// Quantisation tables of the standard's Annex K, natural order
+constexpr std::array<int, JPEG_BLOCK_AREA> LUMA_QUANTISATION { 16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+
+constexpr std::array<int, JPEG_BLOCK_AREA> CHROMA_QUANTISATION { 17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+
+// Huffman tables of Annex K, codes of each length from 1 to 16 and then the symbols they code
+struct HuffmanSpec {
+    std::array<Ubyte, 16> counts;
+    std::vector<Ubyte> symbols;
+};
+
+static const HuffmanSpec LUMA_DC { { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 }, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 } };
+static const HuffmanSpec CHROMA_DC { { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 } };
+
+static const HuffmanSpec LUMA_AC { { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D }, {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA } };
+
+static const HuffmanSpec CHROMA_AC { { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 }, {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA } };
+
+// Code and length of every symbol of a table
+struct HuffmanTable {
+    std::array<Ushort, 256> codes {};
+    std::array<Ubyte, 256> lengths {};
+
+    HuffmanTable(const HuffmanSpec& spec) {
+
+        // Codes of each length follow on from the last, one bit longer
+        Uint32 code = 0;
+        size_t symbol = 0;
+
+        for (int length = 1; length <= 16; ++length) {
+            for (int count = 0; count < spec.counts[length - 1]; ++count) {
+                codes[spec.symbols[symbol]] = static_cast<Ushort>(code++);
+                lengths[spec.symbols[symbol++]] = static_cast<Ubyte>(length);
+            }
+            code <<= 1;
+        }
+    }
+};
+
+// libjpeg's scaling of the base tables, 50 leaves them as they are
+static std::array<int, JPEG_BLOCK_AREA> ScaledQuantisation(const std::array<int, JPEG_BLOCK_AREA>& base, const int quality) {
+
+    const int clamped = std::clamp(quality, 1, 100);
+    const int scale = clamped < 50 ? 5000 / clamped : 200 - 2 * clamped;
+
+    std::array<int, JPEG_BLOCK_AREA> table {};
+    std::transform(base.begin(), base.end(), table.begin(), [scale](const int value) { return std::clamp((value * scale + 50) / 100, 1, 255); });
+
+    return table;
+}
+
+// What a coefficient out of the DCT is multiplied by to quantise it, laid out as the DCT leaves it.
+// The DCT leaves coefficient ( v, u ) at u * 8 + v, scaled by 8 and the AAN factors of u and v
+static std::array<float, JPEG_BLOCK_AREA> Reciprocals(const std::array<int, JPEG_BLOCK_AREA>& table) {
+
+    std::array<double, JPEG_BLOCK_SIZE> aanScales {};
+    for (int k = 0; k < JPEG_BLOCK_SIZE; ++k) { aanScales[k] = k == 0 ? 1 : std::cos(k * 3.14159265358979323846 / 16) * std::sqrt(2.0); }
+
+    std::array<float, JPEG_BLOCK_AREA> reciprocals {};
+
+    for (int v = 0; v < JPEG_BLOCK_SIZE; ++v) {
+        for (int u = 0; u < JPEG_BLOCK_SIZE; ++u) {
+            const double divisor = table[v * JPEG_BLOCK_SIZE + u] * aanScales[v] * aanScales[u] * 8;
+            reciprocals[u * JPEG_BLOCK_SIZE + v] = static_cast<float>(1 / divisor);
+        }
+    }
+
+    return reciprocals;
+}
+
+/* ------------------ */
+
+/* ----- DCT ----- */
+
+#if defined(QUICKSHOT_SSE2)
+
+// A row of 8 16-bit samples. Coefficients of 8-bit samples stay within 16 bits through both passes
+static inline __m128i DctAdd(const __m128i a, const __m128i b) { return _mm_add_epi16(a, b); }
+static inline __m128i DctSub(const __m128i a, const __m128i b) { return _mm_sub_epi16(a, b); }
+
+// Products need 32 bits, put together from their low and high halves
+template <int Constant>
+static inline __m128i DctMultiply(const __m128i value) {
+
+    const __m128i constant = _mm_set1_epi16(Constant);
+    const __m128i round = _mm_set1_epi32(1 << (DCT_CONST_BITS - 1));
+
+    const __m128i low = _mm_mullo_epi16(value, constant);
+    const __m128i high = _mm_mulhi_epi16(value, constant);
+
+    const __m128i first = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low, high), round), DCT_CONST_BITS);
+    const __m128i second = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low, high), round), DCT_CONST_BITS);
+
+    return _mm_packs_epi32(first, second);
+}
+
+#else
+
+// One sample, the block is transformed a column at a time
+static inline int DctAdd(const int a, const int b) { return a + b; }
+static inline int DctSub(const int a, const int b) { return a - b; }
+
+template <int Constant>
+static inline int DctMultiply(const int value) { return (value * Constant + (1 << (DCT_CONST_BITS - 1))) >> DCT_CONST_BITS; }
+
+#endif
+
+// Integer AAN forward DCT of libjpeg's jfdctfst, on 8 lanes at a time. Run on the rows of a block
+// it transforms every column at once, so a block takes two runs with a transpose between them
+template <typename Lanes>
+static inline void AanDct(Lanes (&d)[JPEG_BLOCK_SIZE]) {
+
+    constexpr int FIX_0_382683433 = 98;
+    constexpr int FIX_0_541196100 = 139;
+    constexpr int FIX_0_707106781 = 181;
+    constexpr int FIX_1_306562965 = 334;
+
+    const Lanes tmp0 = DctAdd(d[0], d[7]), tmp7 = DctSub(d[0], d[7]);
+    const Lanes tmp1 = DctAdd(d[1], d[6]), tmp6 = DctSub(d[1], d[6]);
+    const Lanes tmp2 = DctAdd(d[2], d[5]), tmp5 = DctSub(d[2], d[5]);
+    const Lanes tmp3 = DctAdd(d[3], d[4]), tmp4 = DctSub(d[3], d[4]);
+
+    // Even part
+    Lanes tmp10 = DctAdd(tmp0, tmp3);
+    const Lanes tmp13 = DctSub(tmp0, tmp3);
+    Lanes tmp11 = DctAdd(tmp1, tmp2);
+    Lanes tmp12 = DctSub(tmp1, tmp2);
+
+    d[0] = DctAdd(tmp10, tmp11);
+    d[4] = DctSub(tmp10, tmp11);
+
+    const Lanes z1 = DctMultiply<FIX_0_707106781>(DctAdd(tmp12, tmp13));
+    d[2] = DctAdd(tmp13, z1);
+    d[6] = DctSub(tmp13, z1);
+
+    // Odd part
+    tmp10 = DctAdd(tmp4, tmp5);
+    tmp11 = DctAdd(tmp5, tmp6);
+    tmp12 = DctAdd(tmp6, tmp7);
+
+    const Lanes z5 = DctMultiply<FIX_0_382683433>(DctSub(tmp10, tmp12));
+    const Lanes z2 = DctAdd(DctMultiply<FIX_0_541196100>(tmp10), z5);
+    const Lanes z4 = DctAdd(DctMultiply<FIX_1_306562965>(tmp12), z5);
+    const Lanes z3 = DctMultiply<FIX_0_707106781>(tmp11);
+
+    const Lanes z11 = DctAdd(tmp7, z3);
+    const Lanes z13 = DctSub(tmp7, z3);
+
+    d[5] = DctAdd(z13, z2);
+    d[3] = DctSub(z13, z2);
+    d[1] = DctAdd(z11, z4);
+    d[7] = DctSub(z11, z4);
+}
+
+#if defined(QUICKSHOT_SSE2)
+
+static inline void Transpose(__m128i (&rows)[JPEG_BLOCK_SIZE]) {
+
+    const __m128i a0 = _mm_unpacklo_epi16(rows[0], rows[1]), a1 = _mm_unpackhi_epi16(rows[0], rows[1]);
+    const __m128i a2 = _mm_unpacklo_epi16(rows[2], rows[3]), a3 = _mm_unpackhi_epi16(rows[2], rows[3]);
+    const __m128i a4 = _mm_unpacklo_epi16(rows[4], rows[5]), a5 = _mm_unpackhi_epi16(rows[4], rows[5]);
+    const __m128i a6 = _mm_unpacklo_epi16(rows[6], rows[7]), a7 = _mm_unpackhi_epi16(rows[6], rows[7]);
+
+    const __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    const __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    const __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    const __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+
+    rows[0] = _mm_unpacklo_epi64(b0, b4);
+    rows[1] = _mm_unpackhi_epi64(b0, b4);
+    rows[2] = _mm_unpacklo_epi64(b1, b5);
+    rows[3] = _mm_unpackhi_epi64(b1, b5);
+    rows[4] = _mm_unpacklo_epi64(b2, b6);
+    rows[5] = _mm_unpackhi_epi64(b2, b6);
+    rows[6] = _mm_unpacklo_epi64(b3, b7);
+    rows[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+// Transform and quantise the 8x8 block at samples, coefficient ( v, u ) is left at u * 8 + v
+static void TransformBlock(const Ubyte* samples, const size_t stride, const std::array<float, JPEG_BLOCK_AREA>& reciprocals,
+    std::array<short, JPEG_BLOCK_AREA>& coefficients) {
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i center = _mm_set1_epi16(128);
+
+    __m128i rows[JPEG_BLOCK_SIZE];
+    for (int y = 0; y < JPEG_BLOCK_SIZE; ++y) {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples + y * stride));
+        rows[y] = _mm_sub_epi16(_mm_unpacklo_epi8(bytes, zero), center);
+    }
+
+    AanDct(rows);
+    Transpose(rows);
+    AanDct(rows);
+
+    for (int u = 0; u < JPEG_BLOCK_SIZE; ++u) {
+
+        // Widen to 32 bits with the sign, scale by the reciprocal and round to the nearest
+        const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(rows[u], rows[u]), 16);
+        const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(rows[u], rows[u]), 16);
+
+        const __m128 lowScaled = _mm_mul_ps(_mm_cvtepi32_ps(low), _mm_loadu_ps(reciprocals.data() + u * JPEG_BLOCK_SIZE));
+        const __m128 highScaled = _mm_mul_ps(_mm_cvtepi32_ps(high), _mm_loadu_ps(reciprocals.data() + u * JPEG_BLOCK_SIZE + 4));
+
+        const __m128i quantised = _mm_packs_epi32(_mm_cvtps_epi32(lowScaled), _mm_cvtps_epi32(highScaled));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(coefficients.data() + u * JPEG_BLOCK_SIZE), quantised);
+    }
+}
+
+#else
+
+// Transform and quantise the 8x8 block at samples, coefficient ( v, u ) is left at u * 8 + v
+static void TransformBlock(const Ubyte* samples, const size_t stride, const std::array<float, JPEG_BLOCK_AREA>& reciprocals,
+    std::array<short, JPEG_BLOCK_AREA>& coefficients) {
+
+    std::array<std::array<int, JPEG_BLOCK_SIZE>, JPEG_BLOCK_SIZE> block;
+    for (int y = 0; y < JPEG_BLOCK_SIZE; ++y) {
+        for (int x = 0; x < JPEG_BLOCK_SIZE; ++x) { block[y][x] = samples[y * stride + x] - 128; }
+    }
+
+    // Each pass transforms the columns and transposes, so the rows are transformed second
+    for (int pass = 0; pass < 2; ++pass) {
+
+        std::array<std::array<int, JPEG_BLOCK_SIZE>, JPEG_BLOCK_SIZE> transformed;
+
+        for (int column = 0; column < JPEG_BLOCK_SIZE; ++column) {
+
+            int lanes[JPEG_BLOCK_SIZE];
+            for (int row = 0; row < JPEG_BLOCK_SIZE; ++row) { lanes[row] = block[row][column]; }
+
+            AanDct(lanes);
+
+            for (int row = 0; row < JPEG_BLOCK_SIZE; ++row) { transformed[column][row] = lanes[row]; }
+        }
+
+        block = transformed;
+    }
+
+    for (int v = 0; v < JPEG_BLOCK_SIZE; ++v) {
+        for (int u = 0; u < JPEG_BLOCK_SIZE; ++u) {
+            const int index = u * JPEG_BLOCK_SIZE + v;
+            coefficients[index] = static_cast<short>(std::lround(block[v][u] * reciprocals[index]));
+        }
+    }
+}
+
+#endif
+
+/* --------------- */
+
+/* ----- Entropy Coding ----- */
+
+// Writes bits most significant first, stuffing a zero byte after every 0xFF so it can't be read as a marker
+class JpegBitWriter {
+
+private:
+
+    std::vector<Ubyte>& _out;
+    Uint64 _bits = 0;
+    int _count = 0;
+
+    void PutByte(const Ubyte byte) {
+        _out.push_back(byte);
+        if (byte == 0xFF) { _out.push_back(0); }
+    }
+
+public:
+
+    JpegBitWriter(std::vector<Ubyte>& out) : _out(out) {}
+
+    // At most 16 bits at a time
+    void Put(const Uint32 value, const int length) {
+
+        _bits = (_bits << length) | (value & ((1u << length) - 1));
+        _count += length;
+
+        if (_count < 32) { return; }
+
+        _count -= 32;
+        const Uint32 word = static_cast<Uint32>(_bits >> _count);
+
+        // Whole words go out at once unless one of their bytes is 0xFF and needs stuffing
+        if (((~word - 0x01010101u) & word & 0x80808080u) == 0) {
+            _out.insert(_out.end(), { static_cast<Ubyte>(word >> 24), static_cast<Ubyte>(word >> 16), static_cast<Ubyte>(word >> 8), static_cast<Ubyte>(word) });
+            return;
+        }
+
+        for (int shift = 24; shift >= 0; shift -= 8) { PutByte(static_cast<Ubyte>(word >> shift)); }
+    }
+
+    // Pad to a whole byte with 1 bits and write out everything pending
+    void Flush() {
+
+        const int padding = (8 - _count % 8) % 8;
+        _bits = (_bits << padding) | ((1u << padding) - 1);
+        _count += padding;
+
+        for (; _count > 0; _count -= 8) { PutByte(static_cast<Ubyte>(_bits >> (_count - 8))); }
+    }
+};
+
+// Bits needed for the magnitude of value, its size category
+static inline int BitCount(const int value) {
+    const Uint32 magnitude = static_cast<Uint32>(value < 0 ? -value : value);
+    return magnitude == 0 ? 0 : std::bit_width(magnitude);
+}
+
+// Size category then the value's bits, negative values as value - 1 in as many bits
+static inline void PutValue(JpegBitWriter& writer, const HuffmanTable& table, const int symbol, const int value, const int size) {
+    writer.Put(table.codes[symbol], table.lengths[symbol]);
+    if (size > 0) { writer.Put(static_cast<Uint32>(value < 0 ? value - 1 : value), size); }
+}
+
+// Index in TransformBlock's layout of each coefficient in zigzag order, the transpose of ZIGZAG
+constexpr std::array<int, JPEG_BLOCK_AREA> TRANSPOSED_ZIGZAG = [] {
+    std::array<int, JPEG_BLOCK_AREA> indices {};
+    for (int k = 0; k < JPEG_BLOCK_AREA; ++k) { indices[k] = (ZIGZAG[k] % JPEG_BLOCK_SIZE) * JPEG_BLOCK_SIZE + ZIGZAG[k] / JPEG_BLOCK_SIZE; }
+    return indices;
+}();
+
+// Code one quantised block, laid out as TransformBlock leaves it. previousDc carries the prediction on
+static void EncodeBlock(JpegBitWriter& writer, const std::array<short, JPEG_BLOCK_AREA>& coefficients,
+    const HuffmanTable& dcTable, const HuffmanTable& acTable, int& previousDc) {
+
+    const int difference = coefficients[0] - previousDc;
+    previousDc = coefficients[0];
+
+    const int dcSize = BitCount(difference);
+    PutValue(writer, dcTable, dcSize, difference, dcSize);
+
+    // Most AC coefficients quantise to zero, so gather them in zigzag order with a bit for each that didn't
+    std::array<short, JPEG_BLOCK_AREA> zigzag;
+    Uint64 nonZero = 0;
+
+    for (int k = 1; k < JPEG_BLOCK_AREA; ++k) {
+        zigzag[k] = coefficients[TRANSPOSED_ZIGZAG[k]];
+        nonZero |= static_cast<Uint64>(zigzag[k] != 0) << k;
+    }
+
+    int last = 0;
+
+    for (; nonZero != 0; nonZero &= nonZero - 1) {
+
+        const int k = std::countr_zero(nonZero);
+        int run = k - last - 1;
+
+        // Runs over 15 zeros take a ZRL symbol per 16 of them
+        for (; run > 15; run -= 16) { writer.Put(acTable.codes[0xF0], acTable.lengths[0xF0]); }
+
+        const int size = BitCount(zigzag[k]);
+        PutValue(writer, acTable, (run << 4) | size, zigzag[k], size);
+        last = k;
+    }
+
+    // End of block when the last coefficients are zeros
+    if (last < JPEG_BLOCK_AREA - 1) { writer.Put(acTable.codes[0x00], acTable.lengths[0x00]); }
+}
+
+/* -------------------------- */
+
+/* ----- Markers ----- */
+
+static void PutMarker(std::vector<Ubyte>& out, const JpegMarker marker) {
+    out.insert(out.end(), { 0xFF, marker });
+}
+
+// Marker, then its data after a big endian length that counts itself
+static void PutSegment(std::vector<Ubyte>& out, const JpegMarker marker, const std::vector<Ubyte>& data) {
+    const size_t length = data.size() + 2;
+    PutMarker(out, marker);
+    out.insert(out.end(), { static_cast<Ubyte>(length >> 8), static_cast<Ubyte>(length) });
+    out.insert(out.end(), data.begin(), data.end());
+}
+
+static void PutQuantisation(std::vector<Ubyte>& data, const int id, const std::array<int, JPEG_BLOCK_AREA>& table) {
+    data.push_back(static_cast<Ubyte>(id));  // 8-bit entries
+    for (int k = 0; k < JPEG_BLOCK_AREA; ++k) { data.push_back(static_cast<Ubyte>(table[ZIGZAG[k]])); }
+}
+
+static void PutHuffman(std::vector<Ubyte>& data, const int tableClass, const int id, const HuffmanSpec& spec) {
+    data.push_back(static_cast<Ubyte>((tableClass << 4) | id));
+    data.insert(data.end(), spec.counts.begin(), spec.counts.end());
+    data.insert(data.end(), spec.symbols.begin(), spec.symbols.end());
+}
+
+/* ------------------- */
+
+/* ----- JPEG Encoding ----- */
+
+PixelData EncodeJpeg(const ConstImageView& image, const JpegOptions& options) {
+
+    const Resolution& resolution = image.resolution;
+
+    if (BytesPerSample(image.format) != 1) { return {}; }
+    if (resolution.width <= 0 || resolution.height <= 0) { return {}; }
+    if (resolution.width > JPEG_MAX_SIDE || resolution.height > JPEG_MAX_SIDE) { return {}; }
+
+    const bool gray = image.format == PixelFormat::Gray8;
+    if (!gray && ChannelCount(image.format) < 3) { return {}; }
+
+    // Colour MCUs are 16x16, 4 luma blocks and one of each chroma subsampled 2:1 both ways
+    const int mcuSize = gray ? JPEG_BLOCK_SIZE : JPEG_BLOCK_SIZE * 2;
+    const int mcuColumns = (resolution.width + mcuSize - 1) / mcuSize;
+    const int mcuRows = (resolution.height + mcuSize - 1) / mcuSize;
+
+    const int lumaStride = mcuColumns * mcuSize;
+    const int chromaStride = lumaStride / 2;
+    const int chromaWidth = (resolution.width + 1) / 2;
+
+    const std::array<int, JPEG_BLOCK_AREA> lumaTable = ScaledQuantisation(LUMA_QUANTISATION, options.quality);
+    const std::array<int, JPEG_BLOCK_AREA> chromaTable = ScaledQuantisation(CHROMA_QUANTISATION, options.quality);
+
+    const std::array<float, JPEG_BLOCK_AREA> lumaReciprocals = Reciprocals(lumaTable);
+    const std::array<float, JPEG_BLOCK_AREA> chromaReciprocals = Reciprocals(chromaTable);
+
+    const HuffmanTable lumaDc(LUMA_DC), lumaAc(LUMA_AC), chromaDc(CHROMA_DC), chromaAc(CHROMA_AC);
+
+    const YuvWeights weights = WeightsFor(YuvConversion { YuvMatrix::BT601, YuvRange::Full }, image.format);
+
+    // Every MCU row is a restart interval, so strips of them code independently and join up with RST markers
+    std::vector<std::vector<Ubyte>> strips(StripCount(mcuRows, options.threads));
+
+    ForEachStrip(mcuRows, options.threads, [&](const int begin, const int end, const int strip) {
+
+        std::vector<Ubyte>& out = strips[strip];
+        out.reserve(static_cast<size_t>(end - begin) * lumaStride * mcuSize / 8);
+
+        JpegBitWriter writer(out);
+        std::array<short, JPEG_BLOCK_AREA> coefficients;
+
+        std::vector<Ubyte> luma(static_cast<size_t>(lumaStride) * mcuSize);
+        std::vector<Ubyte> cb(gray ? 0 : static_cast<size_t>(chromaStride) * JPEG_BLOCK_SIZE);
+        std::vector<Ubyte> cr(cb.size());
+
+        // Rows past the bottom repeat the last one, columns past the right edge its last sample
+        const auto sourceRow = [&](const int y) {
+            return reinterpret_cast<const Ubyte*>(image.Row(std::min(y, resolution.height - 1)));
+        };
+
+        const auto padRows = [](std::vector<Ubyte>& plane, const int stride, const int rows, const int width) {
+            for (int row = 0; row < rows; ++row) {
+                Ubyte* samples = plane.data() + static_cast<size_t>(row) * stride;
+                std::fill(samples + width, samples + stride, samples[width - 1]);
+            }
+        };
+
+        for (int mcuRow = begin; mcuRow < end; ++mcuRow) {
+
+            const int top = mcuRow * mcuSize;
+
+            if (gray) {
+                for (int row = 0; row < mcuSize; ++row) {
+                    std::memcpy(luma.data() + row * lumaStride, sourceRow(top + row), resolution.width);
+                }
+            }
+            else {
+                for (int row = 0; row < mcuSize; row += 2) {
+                    ToYuvRows(sourceRow(top + row), sourceRow(top + row + 1), image.format, resolution.width, weights,
+                        luma.data() + row * lumaStride, luma.data() + (row + 1) * lumaStride,
+                        cb.data() + row / 2 * chromaStride, cr.data() + row / 2 * chromaStride, 1);
+                }
+
+                padRows(cb, chromaStride, JPEG_BLOCK_SIZE, chromaWidth);
+                padRows(cr, chromaStride, JPEG_BLOCK_SIZE, chromaWidth);
+            }
+
+            padRows(luma, lumaStride, mcuSize, resolution.width);
+
+            int lumaDcPrediction = 0, cbDcPrediction = 0, crDcPrediction = 0;
+
+            for (int mcu = 0; mcu < mcuColumns; ++mcu) {
+
+                const int left = mcu * mcuSize;
+
+                // Luma blocks left to right, top to bottom
+                for (int blockY = 0; blockY < mcuSize; blockY += JPEG_BLOCK_SIZE) {
+                    for (int blockX = 0; blockX < mcuSize; blockX += JPEG_BLOCK_SIZE) {
+                        TransformBlock(luma.data() + blockY * lumaStride + left + blockX, lumaStride, lumaReciprocals, coefficients);
+                        EncodeBlock(writer, coefficients, lumaDc, lumaAc, lumaDcPrediction);
+                    }
+                }
+
+                if (gray) { continue; }
+
+                TransformBlock(cb.data() + left / 2, chromaStride, chromaReciprocals, coefficients);
+                EncodeBlock(writer, coefficients, chromaDc, chromaAc, cbDcPrediction);
+
+                TransformBlock(cr.data() + left / 2, chromaStride, chromaReciprocals, coefficients);
+                EncodeBlock(writer, coefficients, chromaDc, chromaAc, crDcPrediction);
+            }
+
+            writer.Flush();
+
+            // Restart markers count 0 to 7 round, none after the last interval
+            if (mcuRow < mcuRows - 1) { out.insert(out.end(), { 0xFF, static_cast<Ubyte>(JPEG_RST0 + mcuRow % 8) }); }
+        }
+    });
+
+    std::vector<Ubyte> jpeg;
+    PutMarker(jpeg, JPEG_SOI);
+
+    // JFIF 1.01, square pixels at no particular density and no thumbnail
+    PutSegment(jpeg, JPEG_APP0, { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+
+    std::vector<Ubyte> quantisation;
+    PutQuantisation(quantisation, 0, lumaTable);
+    if (!gray) { PutQuantisation(quantisation, 1, chromaTable); }
+    PutSegment(jpeg, JPEG_DQT, quantisation);
+
+    // 8-bit samples, then each component's id, sampling factors and quantisation table
+    std::vector<Ubyte> frame { 8,
+        static_cast<Ubyte>(resolution.height >> 8), static_cast<Ubyte>(resolution.height),
+        static_cast<Ubyte>(resolution.width >> 8), static_cast<Ubyte>(resolution.width),
+        static_cast<Ubyte>(gray ? 1 : 3), 1, static_cast<Ubyte>(gray ? 0x11 : 0x22), 0 };
+    if (!gray) { frame.insert(frame.end(), { 2, 0x11, 1, 3, 0x11, 1 }); }
+    PutSegment(jpeg, JPEG_SOF0, frame);
+
+    std::vector<Ubyte> huffman;
+    PutHuffman(huffman, 0, 0, LUMA_DC);
+    PutHuffman(huffman, 1, 0, LUMA_AC);
+    if (!gray) {
+        PutHuffman(huffman, 0, 1, CHROMA_DC);
+        PutHuffman(huffman, 1, 1, CHROMA_AC);
+    }
+    PutSegment(jpeg, JPEG_DHT, huffman);
+
+    PutSegment(jpeg, JPEG_DRI, { static_cast<Ubyte>(mcuColumns >> 8), static_cast<Ubyte>(mcuColumns) });
+
+    // Each component's DC and AC tables, then the whole of the baseline spectrum
+    std::vector<Ubyte> scan { static_cast<Ubyte>(gray ? 1 : 3), 1, 0x00 };
+    if (!gray) { scan.insert(scan.end(), { 2, 0x11, 3, 0x11 }); }
+    scan.insert(scan.end(), { 0, 63, 0 });
+    PutSegment(jpeg, JPEG_SOS, scan);
+
+    for (const std::vector<Ubyte>& strip : strips) { jpeg.insert(jpeg.end(), strip.begin(), strip.end()); }
+
+    PutMarker(jpeg, JPEG_EOI);
+
+    return PixelData(jpeg.begin(), jpeg.end());
+}
+
+/* ------------------------- */
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Image.h"
+
+/*----------JPEG Encoding----------*/
+
+struct JpegOptions {
+    // 1 - 100, scales the standard quantisation tables the way libjpeg does
+    int quality = 85;
+
+    // 0 uses every core
+    int threads = 0;
+};
+
+// Whole baseline JFIF file of an 8-bit image, empty when it isn't one or is over 65535 pixels on a side.
+// Colour is full range BT.601 YCbCr with 4:2:0 chroma, Gray8 stays one component. Every row of MCUs
+// is a restart interval of its own, so strips of them are coded on separate threads
+PixelData EncodeJpeg(const ConstImageView& image, const JpegOptions& options = {});
+
+/*---------------------------------*/
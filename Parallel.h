@@ -0,0 +1,43 @@
+#pragma once
+
+#include <thread>
+
+#include "TypesAndDefs.h"
+
+/*----------Parallel Strips----------*/
+
+// Threads to use when asked for threads, 0 asks for one per core
+inline int ThreadCount(const int threads = 0) {
+    if (threads > 0) { return threads; }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Strips rows are split into on threads, never more strips than rows
+inline int StripCount(const int rows, const int threads = 0) {
+    return std::max(1, std::min(rows, ThreadCount(threads)));
+}
+
+// Run work(begin, end, strip) on each of StripCount strips of consecutive rows in [0, rows),
+// the calling thread takes the first strip. Returns once every strip is done
+template <typename Work>
+void ForEachStrip(const int rows, const int threads, Work&& work) {
+
+    const int strips = StripCount(rows, threads);
+
+    const auto stripBegin = [rows, strips](const int strip) {
+        return static_cast<int>(static_cast<Uint64>(rows) * strip / strips);
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(strips - 1);
+
+    for (int strip = 1; strip < strips; ++strip) {
+        workers.emplace_back([&work, &stripBegin, strip]() { work(stripBegin(strip), stripBegin(strip + 1), strip); });
+    }
+
+    work(stripBegin(0), stripBegin(1), 0);
+
+    for (std::thread& worker : workers) { worker.join(); }
+}
+
+/*-----------------------------------*/
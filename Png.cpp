@@ -0,0 +1,641 @@
+#include "Png.h"
+#include "Convert.h"
+#include "Parallel.h"
+
+// Fewest rows worth deflating on their own, smaller strips lose too much to restarting the window
+constexpr const int PNG_MIN_STRIP_ROWS = 64;
+
+// Deflate limits
+constexpr const int DEFLATE_WINDOW = 32768;
+constexpr const int DEFLATE_MIN_MATCH = 4;   // Deflate allows 3, hashing 4 bytes is much faster
+constexpr const int DEFLATE_MAX_MATCH = 258;
+constexpr const int DEFLATE_MAX_BITS = 15;
+constexpr const int DEFLATE_MAX_CODE_LENGTH_BITS = 7;
+
+// Symbols gathered before they are Huffman coded as one block
+constexpr const int DEFLATE_BLOCK_SYMBOLS = 1 << 16;
+
+constexpr const int LITERAL_LENGTH_CODES = 286;
+constexpr const int DISTANCE_CODES = 30;
+constexpr const int CODE_LENGTH_CODES = 19;
+constexpr const int END_OF_BLOCK = 256;
+
+constexpr const int MATCH_HASH_BITS = 15;
+
+constexpr const Uint32 ADLER_MODULUS = 65521;
+
+/* ----- Checksums ----- */
+
+static const std::array<Uint32, 256> CRC_TABLE = []() {
+
+    std::array<Uint32, 256> table {};
+
+    for (Uint32 value = 0; value < table.size(); ++value) {
+        Uint32 crc = value;
+        for (int bit = 0; bit < 8; ++bit) { crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1; }
+        table[value] = crc;
+    }
+
+    return table;
+}();
+
+// Running CRC-32, start from 0
+static Uint32 Crc32(Uint32 crc, const Ubyte* data, const size_t size) {
+
+    crc = ~crc;
+    for (size_t index = 0; index < size; ++index) { crc = CRC_TABLE[(crc ^ data[index]) & 0xFF] ^ (crc >> 8); }
+
+    return ~crc;
+}
+
+static Uint32 Adler32(const Ubyte* data, size_t size) {
+
+    // Most bytes that can be summed before the sums could overflow
+    constexpr const size_t ADLER_RUN = 5552;
+
+    Uint32 low = 1, high = 0;
+
+    while (size > 0) {
+
+        const size_t run = std::min(size, ADLER_RUN);
+
+        for (size_t index = 0; index < run; ++index) {
+            low += data[index];
+            high += low;
+        }
+
+        low %= ADLER_MODULUS;
+        high %= ADLER_MODULUS;
+
+        data += run;
+        size -= run;
+    }
+
+    return high << 16 | low;
+}
+
+// Adler-32 of two pieces of data back to back, from each one's own and the second's size
+static Uint32 CombineAdler32(const Uint32 first, const Uint32 second, const size_t secondSize) {
+
+    const Uint64 remainder = secondSize % ADLER_MODULUS;
+
+    const Uint64 low = ((first & 0xFFFF) + (second & 0xFFFF) + ADLER_MODULUS - 1) % ADLER_MODULUS;
+    const Uint64 high = ((first >> 16) + (second >> 16) + remainder * (first & 0xFFFF) + ADLER_MODULUS - remainder) % ADLER_MODULUS;
+
+    return static_cast<Uint32>(high << 16 | low);
+}
+
+/* --------------------- */
+
+/* ----- Huffman Codes ----- */
+
+// Writes bits least significant first, the order deflate packs them in
+class BitWriter {
+
+private:
+
+    std::vector<Ubyte>& _out;
+    Uint64 _bits = 0;
+    int _count = 0;
+
+public:
+
+    BitWriter(std::vector<Ubyte>& out) : _out(out) {}
+
+    // At most 32 bits at a time
+    void Put(const Uint32 value, const int length) {
+
+        _bits |= static_cast<Uint64>(value) << _count;
+        _count += length;
+
+        if (_count >= 32) {
+            for (int byte = 0; byte < 4; ++byte) { _out.push_back(static_cast<Ubyte>(_bits >> (8 * byte))); }
+            _bits >>= 32;
+            _count -= 32;
+        }
+    }
+
+    // Pad to a whole byte and write out everything pending
+    void Flush() {
+
+        for (; _count > 0; _count -= 8) {
+            _out.push_back(static_cast<Ubyte>(_bits));
+            _bits >>= 8;
+        }
+
+        _bits = 0;
+        _count = 0;
+    }
+};
+
+// Code lengths of a Huffman code for frequencies, none longer than maxBits. Unused symbols get 0
+static std::vector<int> CodeLengths(const std::vector<Uint32>& frequencies, const int maxBits) {
+
+    std::vector<int> lengths(frequencies.size(), 0);
+
+    std::vector<int> used;
+    for (int symbol = 0; symbol < static_cast<int>(frequencies.size()); ++symbol) {
+        if (frequencies[symbol] > 0) { used.push_back(symbol); }
+    }
+
+    if (used.empty()) { return lengths; }
+
+    if (used.size() == 1) {
+        lengths[used[0]] = 1;
+        return lengths;
+    }
+
+    // Least frequent first, the order codes are handed out in once lengths are known
+    std::stable_sort(used.begin(), used.end(), [&](const int a, const int b) { return frequencies[a] < frequencies[b]; });
+
+    // Build the tree out of two sorted queues, leaves and merged nodes, which never needs a heap
+    const size_t leaves = used.size();
+    std::vector<Uint64> weights(2 * leaves - 1);
+    std::vector<size_t> parents(2 * leaves - 1, 0);
+
+    for (size_t leaf = 0; leaf < leaves; ++leaf) { weights[leaf] = frequencies[used[leaf]]; }
+
+    size_t nextLeaf = 0, nextNode = leaves;
+
+    const auto takeLightest = [&](const size_t merged) {
+        if (nextLeaf < leaves && (nextNode >= merged || weights[nextLeaf] <= weights[nextNode])) { return nextLeaf++; }
+        return nextNode++;
+    };
+
+    for (size_t merged = leaves; merged < 2 * leaves - 1; ++merged) {
+        const size_t first = takeLightest(merged);
+        const size_t second = takeLightest(merged);
+
+        weights[merged] = weights[first] + weights[second];
+        parents[first] = merged;
+        parents[second] = merged;
+    }
+
+    // Depths from the root down, the root is the last node merged
+    std::vector<int> depths(2 * leaves - 1, 0);
+    for (size_t node = 2 * leaves - 2; node-- > 0;) { depths[node] = depths[parents[node]] + 1; }
+
+    std::vector<int> codesOfLength(std::max(maxBits, 64) + 1, 0);
+    for (size_t leaf = 0; leaf < leaves; ++leaf) { ++codesOfLength[std::min(depths[leaf], 64)]; }
+
+    // Fold codes longer than maxBits in, then lengthen shorter codes until the code is complete again
+    for (size_t length = maxBits + 1; length < codesOfLength.size(); ++length) {
+        codesOfLength[maxBits] += codesOfLength[length];
+        codesOfLength[length] = 0;
+    }
+
+    Uint64 kraft = 0;
+    for (int length = 1; length <= maxBits; ++length) { kraft += static_cast<Uint64>(codesOfLength[length]) << (maxBits - length); }
+
+    while (kraft > (1ull << maxBits)) {
+
+        --codesOfLength[maxBits];
+
+        for (int length = maxBits - 1; length > 0; --length) {
+            if (codesOfLength[length] > 0) {
+                --codesOfLength[length];
+                codesOfLength[length + 1] += 2;
+                break;
+            }
+        }
+
+        --kraft;
+    }
+
+    // Longest codes to the least frequent symbols
+    size_t leaf = 0;
+    for (int length = maxBits; length > 0; --length) {
+        for (int count = 0; count < codesOfLength[length]; ++count) { lengths[used[leaf++]] = length; }
+    }
+
+    return lengths;
+}
+
+// Canonical codes for lengths, bit reversed so they can be written least significant bit first
+static std::vector<Uint32> CanonicalCodes(const std::vector<int>& lengths) {
+
+    std::array<Uint32, DEFLATE_MAX_BITS + 2> lengthCounts {};
+    for (const int length : lengths) { ++lengthCounts[length]; }
+    lengthCounts[0] = 0;
+
+    std::array<Uint32, DEFLATE_MAX_BITS + 2> nextCode {};
+    for (int length = 1; length <= DEFLATE_MAX_BITS; ++length) {
+        nextCode[length] = (nextCode[length - 1] + lengthCounts[length - 1]) << 1;
+    }
+
+    std::vector<Uint32> codes(lengths.size(), 0);
+
+    for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+
+        const int length = lengths[symbol];
+        if (length == 0) { continue; }
+
+        Uint32 code = nextCode[length]++;
+        Uint32 reversed = 0;
+
+        for (int bit = 0; bit < length; ++bit) {
+            reversed = reversed << 1 | (code & 1);
+            code >>= 1;
+        }
+
+        codes[symbol] = reversed;
+    }
+
+    return codes;
+}
+
+/* ------------------------- */
+
+/* ----- Deflate ----- */
+
+// First length and extra bits of each length code, 257 onwards
+constexpr std::array<int, 29> LENGTH_BASES { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr std::array<int, 29> LENGTH_EXTRA_BITS { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+constexpr std::array<int, DISTANCE_CODES> DISTANCE_BASES { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr std::array<int, DISTANCE_CODES> DISTANCE_EXTRA_BITS { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Order code length code lengths are stored in
+constexpr std::array<int, CODE_LENGTH_CODES> CODE_LENGTH_ORDER { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Length code of every match length less DEFLATE_MIN_MATCH ... 3
+static const std::array<Ubyte, DEFLATE_MAX_MATCH - 2> LENGTH_CODES = []() {
+
+    std::array<Ubyte, DEFLATE_MAX_MATCH - 2> codes {};
+
+    for (int code = 0; code < static_cast<int>(LENGTH_BASES.size()); ++code) {
+        for (int length = LENGTH_BASES[code]; length < LENGTH_BASES[code] + (1 << LENGTH_EXTRA_BITS[code]) && length <= DEFLATE_MAX_MATCH; ++length) {
+            codes[length - 3] = static_cast<Ubyte>(code);
+        }
+    }
+
+    return codes;
+}();
+
+static inline int DistanceCode(const int distance) {
+
+    const Uint32 offset = distance - 1;
+    if (offset < 4) { return offset; }
+
+    // Two codes for every power of 2, told apart by the bit after the highest
+    const int highest = 31 - std::countl_zero(offset);
+    return 2 * highest + ((offset >> (highest - 1)) & 1);
+}
+
+// Matches are stored with this bit set, length less 3 above the distance less 1
+constexpr const Uint32 MATCH_SYMBOL = 1u << 31;
+
+// LZ77 symbols of one block and how often each code is used
+struct DeflateBlock {
+    std::vector<Uint32> symbols;
+    std::vector<Uint32> literalLengthCounts = std::vector<Uint32>(LITERAL_LENGTH_CODES, 0);
+    std::vector<Uint32> distanceCounts = std::vector<Uint32>(DISTANCE_CODES, 0);
+
+    void Literal(const Ubyte value) {
+        symbols.push_back(value);
+        ++literalLengthCounts[value];
+    }
+
+    void Match(const int length, const int distance) {
+        symbols.push_back(MATCH_SYMBOL | static_cast<Uint32>(length - 3) << 16 | static_cast<Uint32>(distance - 1));
+        ++literalLengthCounts[END_OF_BLOCK + 1 + LENGTH_CODES[length - 3]];
+        ++distanceCounts[DistanceCode(distance)];
+    }
+
+    void Clear() {
+        symbols.clear();
+        std::fill(literalLengthCounts.begin(), literalLengthCounts.end(), 0);
+        std::fill(distanceCounts.begin(), distanceCounts.end(), 0);
+    }
+};
+
+// Huffman code the block with codes built for it
+static void WriteBlock(DeflateBlock& block, const bool final, BitWriter& writer) {
+
+    block.literalLengthCounts[END_OF_BLOCK] = 1;
+
+    const std::vector<int> literalLengths = CodeLengths(block.literalLengthCounts, DEFLATE_MAX_BITS);
+    std::vector<int> distanceLengths = CodeLengths(block.distanceCounts, DEFLATE_MAX_BITS);
+
+    // At least one distance code has to be described, even when there are no matches
+    if (std::all_of(distanceLengths.begin(), distanceLengths.end(), [](const int length) { return length == 0; })) {
+        distanceLengths[0] = 1;
+    }
+
+    const std::vector<Uint32> literalCodes = CanonicalCodes(literalLengths);
+    const std::vector<Uint32> distanceCodes = CanonicalCodes(distanceLengths);
+
+    int literalCount = LITERAL_LENGTH_CODES;
+    while (literalCount > END_OF_BLOCK + 1 && literalLengths[literalCount - 1] == 0) { --literalCount; }
+
+    int distanceCount = DISTANCE_CODES;
+    while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) { --distanceCount; }
+
+    // Both sets of lengths run length coded as one sequence, 16 repeats the last length, 17 and 18 repeat zeros
+    std::vector<int> lengths(literalLengths.begin(), literalLengths.begin() + literalCount);
+    lengths.insert(lengths.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+
+    std::vector<std::pair<int, int>> runs;  // Code length symbol and its extra bits
+    std::vector<Uint32> codeLengthCounts(CODE_LENGTH_CODES, 0);
+
+    for (size_t index = 0; index < lengths.size();) {
+
+        const int length = lengths[index];
+
+        size_t run = 1;
+        while (index + run < lengths.size() && lengths[index + run] == length) { ++run; }
+
+        if (length == 0 && run >= 11) {
+            run = std::min<size_t>(run, 138);
+            runs.emplace_back(18, static_cast<int>(run - 11));
+        }
+        else if (length == 0 && run >= 3) {
+            runs.emplace_back(17, static_cast<int>(run - 3));
+        }
+        else if (length != 0 && run >= 4) {
+            run = std::min<size_t>(run - 1, 6) + 1;
+            runs.emplace_back(length, 0);
+            runs.emplace_back(16, static_cast<int>(run - 4));
+        }
+        else {
+            run = 1;
+            runs.emplace_back(length, 0);
+        }
+
+        index += run;
+    }
+
+    for (const auto& [symbol, extra] : runs) { ++codeLengthCounts[symbol]; }
+
+    const std::vector<int> codeLengthLengths = CodeLengths(codeLengthCounts, DEFLATE_MAX_CODE_LENGTH_BITS);
+    const std::vector<Uint32> codeLengthCodes = CanonicalCodes(codeLengthLengths);
+
+    int codeLengthCount = CODE_LENGTH_CODES;
+    while (codeLengthCount > 4 && codeLengthLengths[CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0) { --codeLengthCount; }
+
+    // Header, BTYPE 2 is dynamic Huffman codes
+    writer.Put(final ? 1 : 0, 1);
+    writer.Put(2, 2);
+    writer.Put(literalCount - 257, 5);
+    writer.Put(distanceCount - 1, 5);
+    writer.Put(codeLengthCount - 4, 4);
+
+    for (int index = 0; index < codeLengthCount; ++index) { writer.Put(codeLengthLengths[CODE_LENGTH_ORDER[index]], 3); }
+
+    for (const auto& [symbol, extra] : runs) {
+
+        writer.Put(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+
+        if (symbol == 16) { writer.Put(extra, 2); }
+        else if (symbol == 17) { writer.Put(extra, 3); }
+        else if (symbol == 18) { writer.Put(extra, 7); }
+    }
+
+    for (const Uint32 symbol : block.symbols) {
+
+        if ((symbol & MATCH_SYMBOL) == 0) {
+            writer.Put(literalCodes[symbol], literalLengths[symbol]);
+            continue;
+        }
+
+        const int length = ((symbol >> 16) & 0xFF) + 3;
+        const int distance = (symbol & 0xFFFF) + 1;
+
+        const int lengthCode = LENGTH_CODES[length - 3];
+        writer.Put(literalCodes[END_OF_BLOCK + 1 + lengthCode], literalLengths[END_OF_BLOCK + 1 + lengthCode]);
+        writer.Put(length - LENGTH_BASES[lengthCode], LENGTH_EXTRA_BITS[lengthCode]);
+
+        const int distanceCode = DistanceCode(distance);
+        writer.Put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+        writer.Put(distance - DISTANCE_BASES[distanceCode], DISTANCE_EXTRA_BITS[distanceCode]);
+    }
+
+    writer.Put(literalCodes[END_OF_BLOCK], literalLengths[END_OF_BLOCK]);
+
+    block.Clear();
+}
+
+static inline Uint32 Load32(const Ubyte* data) {
+    Uint32 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Bytes from a and b that are the same, up to limit
+static inline int MatchLength(const Ubyte* a, const Ubyte* b, const int limit) {
+
+    int length = 0;
+
+    for (; length + 8 <= limit; length += 8) {
+
+        Uint64 first, second;
+        std::memcpy(&first, a + length, sizeof(first));
+        std::memcpy(&second, b + length, sizeof(second));
+
+        if (first != second) { return length + std::countr_zero(first ^ second) / 8; }
+    }
+
+    while (length < limit && a[length] == b[length]) { ++length; }
+
+    return length;
+}
+
+// Deflate data as blocks of their own, the window starts empty. The last block of a final piece ends
+// the stream, other pieces end on an empty stored block so the next piece starts on a whole byte
+static void Deflate(const Ubyte* data, const size_t size, const bool final, std::vector<Ubyte>& out) {
+
+    BitWriter writer(out);
+    DeflateBlock block;
+    block.symbols.reserve(DEFLATE_BLOCK_SYMBOLS);
+
+    // Latest position + 1 of every hash of 4 bytes, 0 when there is none yet
+    std::vector<Uint32> latest(1 << MATCH_HASH_BITS, 0);
+    const auto hash = [](const Uint32 bytes) { return (bytes * 2654435761u) >> (32 - MATCH_HASH_BITS); };
+
+    size_t position = 0;
+
+    while (position + DEFLATE_MIN_MATCH <= size) {
+
+        const Uint32 bytes = Load32(data + position);
+        Uint32& slot = latest[hash(bytes)];
+        const size_t candidate = slot;
+        slot = static_cast<Uint32>(position + 1);
+
+        if (candidate > 0 && position - (candidate - 1) <= DEFLATE_WINDOW && Load32(data + candidate - 1) == bytes) {
+
+            const int limit = static_cast<int>(std::min<size_t>(DEFLATE_MAX_MATCH, size - position));
+            const int length = DEFLATE_MIN_MATCH + MatchLength(data + position + DEFLATE_MIN_MATCH,
+                data + candidate - 1 + DEFLATE_MIN_MATCH, limit - DEFLATE_MIN_MATCH);
+
+            block.Match(length, static_cast<int>(position - (candidate - 1)));
+            position += length;
+
+            // Only the end of a match is remembered, filling in every position costs more than it finds
+            if (position + DEFLATE_MIN_MATCH <= size) {
+                latest[hash(Load32(data + position - 1))] = static_cast<Uint32>(position);
+            }
+        }
+        else {
+            block.Literal(data[position++]);
+        }
+
+        if (block.symbols.size() >= DEFLATE_BLOCK_SYMBOLS) { WriteBlock(block, false, writer); }
+    }
+
+    while (position < size) { block.Literal(data[position++]); }
+
+    WriteBlock(block, final, writer);
+
+    if (!final) {
+        writer.Put(0, 3);
+        writer.Flush();
+        out.insert(out.end(), { 0x00, 0x00, 0xFF, 0xFF });
+    }
+
+    writer.Flush();
+}
+
+/* ------------------- */
+
+/* ----- PNG ----- */
+
+enum PngColorType : Ubyte {
+    PNG_GRAY = 0,
+    PNG_RGB = 2,
+    PNG_RGBA = 6
+};
+
+static void PutBigEndian(std::vector<Ubyte>& out, const Uint32 value) {
+    out.insert(out.end(), { static_cast<Ubyte>(value >> 24), static_cast<Ubyte>(value >> 16),
+        static_cast<Ubyte>(value >> 8), static_cast<Ubyte>(value) });
+}
+
+// Append a chunk, its length, type, data and CRC
+static void PutChunk(std::vector<Ubyte>& out, const char* type, const std::vector<Ubyte>& data) {
+
+    PutBigEndian(out, static_cast<Uint32>(data.size()));
+
+    const size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+
+    PutBigEndian(out, Crc32(0, out.data() + typeStart, out.size() - typeStart));
+}
+
+// Filter a row with whichever of Sub and Up leaves smaller bytes, the usual guess at what compresses best.
+// previous is the row above unfiltered, all zeros for the first row, where Up is the same as no filter
+static void FilterRow(const Ubyte* row, const Ubyte* previous, const size_t size, const size_t pixelSize,
+    Ubyte* filtered, std::vector<Ubyte>& scratch) {
+
+    enum Filter : Ubyte { SUB = 1, UP = 2 };
+
+    // Small negative differences cost as little as small positive ones
+    const auto cost = [](const Ubyte value) { return static_cast<Uint32>(std::min<int>(value, 256 - value)); };
+
+    Uint32 upCost = 0, subCost = 0;
+
+    for (size_t index = 0; index < size; ++index) {
+        filtered[1 + index] = static_cast<Ubyte>(row[index] - previous[index]);
+        upCost += cost(filtered[1 + index]);
+    }
+
+    scratch.resize(size);
+
+    for (size_t index = 0; index < size; ++index) {
+        scratch[index] = static_cast<Ubyte>(row[index] - (index >= pixelSize ? row[index - pixelSize] : 0));
+        subCost += cost(scratch[index]);
+    }
+
+    filtered[0] = UP;
+
+    if (subCost < upCost) {
+        filtered[0] = SUB;
+        std::copy(scratch.begin(), scratch.end(), filtered + 1);
+    }
+}
+
+PixelData EncodePng(const ConstImageView& image, const PngOptions& options) {
+
+    if (BytesPerSample(image.format) != 1) { return {}; }
+
+    const Resolution& resolution = image.resolution;
+
+    PixelFormat pngFormat = options.alpha && ChannelOrder(image.format)[3] >= 0 ? PixelFormat::RGBA32 : PixelFormat::RGB24;
+    if (image.format == PixelFormat::Gray8) { pngFormat = PixelFormat::Gray8; }
+
+    PngColorType colorType = PNG_RGB;
+    if (pngFormat == PixelFormat::RGBA32) { colorType = PNG_RGBA; }
+    if (pngFormat == PixelFormat::Gray8) { colorType = PNG_GRAY; }
+
+    if (!CanConvert(image.format, pngFormat)) { return {}; }
+
+    const size_t pixelSize = BytesPerPixel(pngFormat);
+    const size_t rowSize = resolution.width * pixelSize;
+
+    // Every strip is deflated as its own IDAT chunk, the chunks together are one zlib stream
+    const int threads = std::min(ThreadCount(options.threads), std::max(1, resolution.height / PNG_MIN_STRIP_ROWS));
+    const int strips = StripCount(resolution.height, threads);
+
+    std::vector<std::vector<Ubyte>> chunks(strips);
+    std::vector<Uint32> adlers(strips);
+    std::vector<size_t> sizes(strips);
+
+    ForEachStrip(resolution.height, threads, [&](const int begin, const int end, const int strip) {
+
+        std::vector<Ubyte> filtered((end - begin) * (rowSize + 1));
+        std::vector<Ubyte> current(rowSize), previous(rowSize, 0), scratch;
+
+        const auto pngRow = [&](const int y, std::vector<Ubyte>& converted) {
+            ConvertRow(image.Row(y), image.format, reinterpret_cast<MyByte*>(converted.data()), pngFormat, resolution.width);
+        };
+
+        if (begin > 0) { pngRow(begin - 1, previous); }
+
+        for (int y = begin; y < end; ++y) {
+            pngRow(y, current);
+            FilterRow(current.data(), previous.data(), rowSize, pixelSize, filtered.data() + (y - begin) * (rowSize + 1), scratch);
+            std::swap(current, previous);
+        }
+
+        adlers[strip] = Adler32(filtered.data(), filtered.size());
+        sizes[strip] = filtered.size();
+
+        std::vector<Ubyte> compressed;
+        compressed.reserve(filtered.size() / 4);
+
+        // zlib header, deflate with a 32K window and the check bits that make it a multiple of 31
+        if (strip == 0) { compressed.insert(compressed.end(), { 0x78, 0x01 }); }
+
+        Deflate(filtered.data(), filtered.size(), strip == strips - 1, compressed);
+
+        PutChunk(chunks[strip], "IDAT", compressed);
+    });
+
+    Uint32 adler = adlers[0];
+    for (int strip = 1; strip < strips; ++strip) { adler = CombineAdler32(adler, adlers[strip], sizes[strip]); }
+
+    std::vector<Ubyte> header;
+    PutBigEndian(header, resolution.width);
+    PutBigEndian(header, resolution.height);
+    header.insert(header.end(), { BITS_PER_CHANNEL, colorType, 0, 0, 0 });  // No compression, filter or interlace options
+
+    std::vector<Ubyte> checksum;
+    PutBigEndian(checksum, adler);
+
+    std::vector<Ubyte> png { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    PutChunk(png, "IHDR", header);
+    for (const std::vector<Ubyte>& chunk : chunks) { png.insert(png.end(), chunk.begin(), chunk.end()); }
+
+    // The zlib stream's checksum comes last, in an IDAT of its own
+    PutChunk(png, "IDAT", checksum);
+    PutChunk(png, "IEND", {});
+
+    return PixelData(png.begin(), png.end());
+}
+
+/* --------------- */
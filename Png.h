@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Image.h"
+
+/*----------PNG Encoding----------*/
+
+struct PngOptions {
+    // Keep alpha in RGBA, by default it is dropped as screens never fill it in
+    bool alpha = false;
+
+    // 0 uses every core
+    int threads = 0;
+};
+
+// Whole PNG file of an 8-bit image, empty for deep colour. Gray8 stays grayscale, colour is stored as RGB or RGBA.
+// Each row is filtered with Sub or Up, whichever leaves smaller bytes, and strips of rows are deflated in parallel
+PixelData EncodePng(const ConstImageView& image, const PngOptions& options = {});
+
+/*--------------------------------*/
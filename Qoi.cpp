@@ -0,0 +1,389 @@
+#include "Qoi.h"
+#include "Convert.h"
+#include "Parallel.h"
+
+constexpr const int QOI_HEADER_SIZE = 14;
+constexpr const std::array<Ubyte, 8> QOI_END_MARKER { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+// Colours the encoder and decoder remember, found by QoiHash
+constexpr const int QOI_INDEX_SIZE = 64;
+
+// Longest run one op holds
+constexpr const int QOI_MAX_RUN = 62;
+
+// Most pixels a file may claim, guards the decoder against absurd headers
+constexpr const Uint64 QOI_MAX_PIXELS = 400000000;
+
+// Pixel both the encoder and decoder take to come before the first one, opaque black as 0xAARRGGBB
+constexpr const Uint32 QOI_START = 0xFF000000;
+
+// Fewest rows worth a strip of their own
+constexpr const int QOI_MIN_STRIP_ROWS = 16;
+
+enum QoiOp : Ubyte {
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF = 0x40,
+    QOI_OP_LUMA = 0x80,
+    QOI_OP_RUN = 0xC0,
+    QOI_OP_RGB = 0xFE,
+    QOI_OP_RGBA = 0xFF,
+    QOI_OP_MASK = 0xC0
+};
+
+/* ----- Pixels ----- */
+
+// Pixels are kept as BGRA32 is laid out in memory, 0xAARRGGBB
+static inline int Blue(const Uint32 pixel) { return pixel & 0xFF; }
+static inline int Green(const Uint32 pixel) { return (pixel >> 8) & 0xFF; }
+static inline int Red(const Uint32 pixel) { return (pixel >> 16) & 0xFF; }
+static inline int Alpha(const Uint32 pixel) { return pixel >> 24; }
+
+static inline Uint32 Pack(const int red, const int green, const int blue, const int alpha) {
+    return static_cast<Uint32>(alpha & 0xFF) << 24 | static_cast<Uint32>(red & 0xFF) << 16
+        | static_cast<Uint32>(green & 0xFF) << 8 | static_cast<Uint32>(blue & 0xFF);
+}
+
+static inline int QoiHash(const Uint32 pixel) {
+    return (Red(pixel) * 3 + Green(pixel) * 5 + Blue(pixel) * 7 + Alpha(pixel) * 11) % QOI_INDEX_SIZE;
+}
+
+// Reads rows of an image as BGRA32 pixels, alpha forced opaque unless it is kept
+class QoiRowReader {
+
+private:
+
+    const ConstImageView& _image;
+    const Uint32 _opaque;
+    std::vector<MyByte> _scratch;
+
+public:
+
+    QoiRowReader(const ConstImageView& image, const bool alpha) :
+        _image(image), _opaque(alpha && ChannelOrder(image.format)[3] >= 0 ? 0 : 0xFF000000) {}
+
+    const Ubyte* Row(const int y) {
+
+        if (_image.format == PixelFormat::BGRA32) { return reinterpret_cast<const Ubyte*>(_image.Row(y)); }
+
+        _scratch.resize(_image.resolution.width * BytesPerPixel(PixelFormat::BGRA32));
+        ConvertRow(_image.Row(y), _image.format, _scratch.data(), PixelFormat::BGRA32, _image.resolution.width);
+
+        return reinterpret_cast<const Ubyte*>(_scratch.data());
+    }
+
+    Uint32 Pixel(const Ubyte* row, const int x) const {
+        Uint32 pixel;
+        std::memcpy(&pixel, row + x * sizeof(pixel), sizeof(pixel));
+        return pixel | _opaque;
+    }
+};
+
+/* ------------------ */
+
+/* ----- Encoding ----- */
+
+// What the encoder remembers going into a pixel
+struct QoiState {
+    std::array<Uint32, QOI_INDEX_SIZE> index {};
+    Uint32 previous = QOI_START;
+    int run = 0;   // Pixels repeating previous not yet written out
+};
+
+// Last pixel of each hash in rows [begin, end), and which hashes turned up at all. Pixels repeating
+// QOI_START at the very start are left out, they only enter the index if something else came before them
+struct QoiIndexUpdate {
+    std::array<Uint32, QOI_INDEX_SIZE> index {};
+    std::array<bool, QOI_INDEX_SIZE> seen {};
+    bool leadingStart = false;
+    Uint32 last = 0;
+    int trailing = 0;   // Pixels at the end repeating last, all of them when the rows are one colour
+    bool uniform = false;
+};
+
+static QoiIndexUpdate IndexAfter(QoiRowReader& reader, const int width, const int begin, const int end) {
+
+    QoiIndexUpdate update;
+
+    bool leading = true;
+    Uint64 pixels = 0;
+
+    for (int y = begin; y < end; ++y) {
+
+        const Ubyte* row = reader.Row(y);
+
+        for (int x = 0; x < width; ++x, ++pixels) {
+
+            const Uint32 pixel = reader.Pixel(row, x);
+
+            update.trailing = pixels > 0 && pixel == update.last ? update.trailing + 1 : 1;
+            update.last = pixel;
+
+            leading = leading && pixel == QOI_START;
+            if (leading) {
+                update.leadingStart = true;
+                continue;
+            }
+
+            const int hash = QoiHash(pixel);
+            update.index[hash] = pixel;
+            update.seen[hash] = true;
+        }
+    }
+
+    update.uniform = pixels > 0 && static_cast<Uint64>(update.trailing) == pixels;
+
+    return update;
+}
+
+// Where a single pass would be going into the rows after those update describes, starting from state
+static QoiState StateAfter(const QoiState& state, const QoiIndexUpdate& update, const bool onlyStartBefore) {
+
+    if (update.trailing == 0) { return state; }
+
+    QoiState after = state;
+
+    // Repeats of QOI_START are runs until something else turns up, then the next one is indexed
+    if (update.leadingStart && !onlyStartBefore) { after.index[QoiHash(QOI_START)] = QOI_START; }
+
+    for (int hash = 0; hash < QOI_INDEX_SIZE; ++hash) {
+        if (update.seen[hash]) { after.index[hash] = update.index[hash]; }
+    }
+
+    // A run carries on through rows of the colour it is repeating, otherwise the first of the trailing pixels starts a new one
+    const bool continues = update.uniform && update.last == state.previous;
+    after.run = ((continues ? state.run + 1 : 0) + update.trailing - 1) % QOI_MAX_RUN;
+    after.previous = update.last;
+
+    return after;
+}
+
+// Encode rows [begin, end) starting from state. A run still going at the end is written out when
+// finish is set, otherwise the rows after carry it on
+static void EncodeRows(QoiRowReader& reader, const int width, const int begin, const int end, QoiState state,
+    const bool finish, std::vector<Ubyte>& out) {
+
+    // Every pixel takes at most an RGBA op
+    out.resize(static_cast<size_t>(end - begin) * width * 5);
+    Ubyte* bytes = out.data();
+
+    Uint32 previous = state.previous;
+    int run = state.run;
+
+    for (int y = begin; y < end; ++y) {
+
+        const Ubyte* row = reader.Row(y);
+
+        for (int x = 0; x < width; ++x) {
+
+            const Uint32 pixel = reader.Pixel(row, x);
+
+            if (pixel == previous) {
+                if (++run == QOI_MAX_RUN) {
+                    *bytes++ = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                *bytes++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            const int hash = QoiHash(pixel);
+
+            if (state.index[hash] == pixel) {
+                *bytes++ = QOI_OP_INDEX | hash;
+                previous = pixel;
+                continue;
+            }
+
+            state.index[hash] = pixel;
+
+            if (Alpha(pixel) != Alpha(previous)) {
+                *bytes++ = QOI_OP_RGBA;
+                *bytes++ = Red(pixel);
+                *bytes++ = Green(pixel);
+                *bytes++ = Blue(pixel);
+                *bytes++ = Alpha(pixel);
+                previous = pixel;
+                continue;
+            }
+
+            // Differences wrap around like the bytes do
+            const int red = static_cast<signed char>(Red(pixel) - Red(previous));
+            const int green = static_cast<signed char>(Green(pixel) - Green(previous));
+            const int blue = static_cast<signed char>(Blue(pixel) - Blue(previous));
+
+            const int redLessGreen = red - green;
+            const int blueLessGreen = blue - green;
+
+            if (red >= -2 && red <= 1 && green >= -2 && green <= 1 && blue >= -2 && blue <= 1) {
+                *bytes++ = QOI_OP_DIFF | (red + 2) << 4 | (green + 2) << 2 | (blue + 2);
+            }
+            else if (green >= -32 && green <= 31 && redLessGreen >= -8 && redLessGreen <= 7 && blueLessGreen >= -8 && blueLessGreen <= 7) {
+                *bytes++ = QOI_OP_LUMA | (green + 32);
+                *bytes++ = (redLessGreen + 8) << 4 | (blueLessGreen + 8);
+            }
+            else {
+                *bytes++ = QOI_OP_RGB;
+                *bytes++ = Red(pixel);
+                *bytes++ = Green(pixel);
+                *bytes++ = Blue(pixel);
+            }
+
+            previous = pixel;
+        }
+    }
+
+    if (finish && run > 0) { *bytes++ = QOI_OP_RUN | (run - 1); }
+
+    out.resize(bytes - out.data());
+}
+
+static void PutBigEndian(PixelData& out, const Uint32 value) {
+    out.insert(out.end(), { static_cast<MyByte>(value >> 24), static_cast<MyByte>(value >> 16),
+        static_cast<MyByte>(value >> 8), static_cast<MyByte>(value) });
+}
+
+PixelData EncodeQoi(const ConstImageView& image, const QoiOptions& options) {
+
+    if (BytesPerSample(image.format) != 1 || !CanConvert(image.format, PixelFormat::BGRA32)) { return {}; }
+
+    const Resolution& resolution = image.resolution;
+    const bool alpha = options.alpha && ChannelOrder(image.format)[3] >= 0;
+
+    const int threads = std::min(ThreadCount(options.threads), std::max(1, resolution.height / QOI_MIN_STRIP_ROWS));
+    const int strips = StripCount(resolution.height, threads);
+
+    std::vector<QoiIndexUpdate> updates(strips);
+
+    // Where every strip leaves the index and run, so the strips after it know where to start from
+    if (strips > 1) {
+        ForEachStrip(resolution.height, threads, [&](const int begin, const int end, const int strip) {
+
+            if (strip == strips - 1 || begin == end) { return; }
+
+            QoiRowReader reader(image, options.alpha);
+            updates[strip] = IndexAfter(reader, resolution.width, begin, end);
+        });
+    }
+
+    std::vector<QoiState> states(strips);
+
+    // Whether every pixel so far repeats QOI_START
+    bool onlyStart = true;
+
+    for (int strip = 1; strip < strips; ++strip) {
+
+        const QoiIndexUpdate& update = updates[strip - 1];
+        states[strip] = StateAfter(states[strip - 1], update, onlyStart);
+
+        onlyStart = onlyStart && (update.trailing == 0 || (update.uniform && update.last == QOI_START));
+    }
+
+    std::vector<std::vector<Ubyte>> encoded(strips);
+
+    ForEachStrip(resolution.height, threads, [&](const int begin, const int end, const int strip) {
+        QoiRowReader reader(image, options.alpha);
+        EncodeRows(reader, resolution.width, begin, end, states[strip], strip == strips - 1, encoded[strip]);
+    });
+
+    size_t size = QOI_HEADER_SIZE + QOI_END_MARKER.size();
+    for (const std::vector<Ubyte>& bytes : encoded) { size += bytes.size(); }
+
+    PixelData qoi { 'q', 'o', 'i', 'f' };
+    qoi.reserve(size);
+
+    PutBigEndian(qoi, resolution.width);
+    PutBigEndian(qoi, resolution.height);
+    qoi.push_back(alpha ? 4 : 3);
+    qoi.push_back(0);  // sRGB with linear alpha
+
+    for (const std::vector<Ubyte>& bytes : encoded) { qoi.insert(qoi.end(), bytes.begin(), bytes.end()); }
+    qoi.insert(qoi.end(), QOI_END_MARKER.begin(), QOI_END_MARKER.end());
+
+    return qoi;
+}
+
+/* -------------------- */
+
+/* ----- Decoding ----- */
+
+static Uint32 ReadBigEndian(const Ubyte* bytes) {
+    return static_cast<Uint32>(bytes[0]) << 24 | static_cast<Uint32>(bytes[1]) << 16 | static_cast<Uint32>(bytes[2]) << 8 | bytes[3];
+}
+
+ImageBuffer DecodeQoi(std::span<const MyByte> qoi) {
+
+    const Ubyte* bytes = reinterpret_cast<const Ubyte*>(qoi.data());
+
+    if (qoi.size() < QOI_HEADER_SIZE + QOI_END_MARKER.size() || std::memcmp(bytes, "qoif", 4) != 0) { return {}; }
+
+    const Uint32 width = ReadBigEndian(bytes + 4);
+    const Uint32 height = ReadBigEndian(bytes + 8);
+    const Ubyte channels = bytes[12];
+
+    if (width == 0 || height == 0 || (channels != 3 && channels != 4)
+        || static_cast<Uint64>(width) * height > QOI_MAX_PIXELS) { return {}; }
+
+    ImageBuffer decoded({ static_cast<int>(width), static_cast<int>(height) });
+    MyByte* out = decoded.View().data;
+
+    std::array<Uint32, QOI_INDEX_SIZE> index {};
+    Uint32 pixel = QOI_START;
+    int run = 0;
+
+    // Ops never reach into the end marker, so each can read all its bytes once it starts before it
+    size_t position = QOI_HEADER_SIZE;
+    const size_t opsEnd = qoi.size() - QOI_END_MARKER.size();
+
+    const Uint64 pixels = static_cast<Uint64>(width) * height;
+
+    for (Uint64 count = 0; count < pixels; ++count) {
+
+        if (run > 0) {
+            --run;
+        }
+        else {
+
+            // Truncated, the ops ran out before the pixels did
+            if (position >= opsEnd) { return {}; }
+
+            const Ubyte op = bytes[position++];
+
+            if (op == QOI_OP_RGB) {
+                pixel = Pack(bytes[position], bytes[position + 1], bytes[position + 2], Alpha(pixel));
+                position += 3;
+            }
+            else if (op == QOI_OP_RGBA) {
+                pixel = Pack(bytes[position], bytes[position + 1], bytes[position + 2], bytes[position + 3]);
+                position += 4;
+            }
+            else if ((op & QOI_OP_MASK) == QOI_OP_INDEX) {
+                pixel = index[op];
+            }
+            else if ((op & QOI_OP_MASK) == QOI_OP_DIFF) {
+                pixel = Pack(Red(pixel) + ((op >> 4) & 3) - 2, Green(pixel) + ((op >> 2) & 3) - 2,
+                    Blue(pixel) + (op & 3) - 2, Alpha(pixel));
+            }
+            else if ((op & QOI_OP_MASK) == QOI_OP_LUMA) {
+                const int green = (op & 0x3F) - 32;
+                const Ubyte differences = bytes[position++];
+                pixel = Pack(Red(pixel) + green - 8 + (differences >> 4), Green(pixel) + green,
+                    Blue(pixel) + green - 8 + (differences & 0xF), Alpha(pixel));
+            }
+            else {
+                run = op & 0x3F;
+            }
+
+            index[QoiHash(pixel)] = pixel;
+        }
+
+        std::memcpy(out + count * sizeof(pixel), &pixel, sizeof(pixel));
+    }
+
+    return decoded;
+}
+
+/* -------------------- */
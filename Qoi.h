@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Image.h"
+
+/*----------QOI Encoding----------*/
+
+struct QoiOptions {
+    // Keep alpha, by default it is written opaque as screens never fill it in
+    bool alpha = false;
+
+    // 0 uses every core, 1 encodes in one pass without looking ahead
+    int threads = 0;
+};
+
+// Whole QOI file of an 8-bit colour image, empty when image can't be converted to BGRA32.
+// Strips of rows are encoded in parallel, each from the index, previous pixel and unfinished run
+// a single pass would reach, so the file is byte for byte the same whatever the thread count
+PixelData EncodeQoi(const ConstImageView& image, const QoiOptions& options = {});
+
+// BGRA32 image of a QOI file, empty when the file is malformed
+ImageBuffer DecodeQoi(std::span<const MyByte> qoi);
+
+/*--------------------------------*/
@@ -0,0 +1,512 @@
+#include <atomic>
+
+#include "Quantize.h"
+#include "Parallel.h"
+
+// Bits kept of each channel by the histogram the octree is built over, its depth
+constexpr const int HISTOGRAM_BITS = 5;
+constexpr const int HISTOGRAM_BINS = 1 << (3 * HISTOGRAM_BITS);
+
+// Passes refining the octree's palette over the histogram
+constexpr const int KMEANS_PASSES = 2;
+
+// Side of the Bayer matrix used for ordered dithering
+constexpr const int BAYER_SIZE = 8;
+
+// Never a colour, those leave the top byte clear
+constexpr const Uint32 NO_COLOR = 0xFFFFFFFF;
+
+/* ----- Pixels ----- */
+
+// Row y of image as BGRA32, converted into scratch when it is in another format
+static const Ubyte* BgraRow(const ConstImageView& image, const int y, std::vector<MyByte>& scratch) {
+
+    if (image.format == PixelFormat::BGRA32) { return reinterpret_cast<const Ubyte*>(image.Row(y)); }
+
+    scratch.resize(image.resolution.width * BytesPerPixel(PixelFormat::BGRA32));
+    ConvertRow(image.Row(y), image.format, scratch.data(), PixelFormat::BGRA32, image.resolution.width);
+
+    return reinterpret_cast<const Ubyte*>(scratch.data());
+}
+
+// Colour of pixel x of a BGRA32 row as 0x00RRGGBB
+static inline Uint32 ColorAt(const Ubyte* row, const int x) {
+    Uint32 pixel;
+    std::memcpy(&pixel, row + x * sizeof(pixel), sizeof(pixel));
+    return pixel & 0xFFFFFF;
+}
+
+static inline int Blue(const Uint32 color) { return color & 0xFF; }
+static inline int Green(const Uint32 color) { return (color >> 8) & 0xFF; }
+static inline int Red(const Uint32 color) { return (color >> 16) & 0xFF; }
+
+// Histogram bin of a colour, the top HISTOGRAM_BITS of red, green and blue
+static inline Uint32 BinOf(const Uint32 color) {
+    return ((color >> 3) & 0x1F) | ((color >> 6) & 0x3E0) | ((color >> 9) & 0x7C00);
+}
+
+/* ------------------ */
+
+/* ----- Exact Palette ----- */
+
+// Open addressing table of up to MAX_PALETTE_COLORS colours and their palette indices, small enough to stay in L1
+class ColorTable {
+
+private:
+
+    static constexpr const int SLOT_BITS = 10;
+
+    std::array<Uint32, 1 << SLOT_BITS> _colors;
+    std::array<Ubyte, 1 << SLOT_BITS> _indices {};
+    int _size = 0;
+
+    static Uint32 Slot(const Uint32 color) { return (color * 0x9E3779B1u) >> (32 - SLOT_BITS); }
+
+public:
+
+    ColorTable() { _colors.fill(NO_COLOR); }
+
+    int Size() const { return _size; }
+
+    // False when color was already in the table, insert at most ( 1 << SLOT_BITS ) / 2 colours
+    bool Insert(const Uint32 color, const Ubyte index = 0) {
+
+        Uint32 slot = Slot(color);
+
+        for (; _colors[slot] != NO_COLOR; slot = (slot + 1) & (_colors.size() - 1)) {
+            if (_colors[slot] == color) { return false; }
+        }
+
+        _colors[slot] = color;
+        _indices[slot] = index;
+        ++_size;
+
+        return true;
+    }
+
+    // Index of a colour that was inserted
+    Ubyte Find(const Uint32 color) const {
+
+        Uint32 slot = Slot(color);
+        while (_colors[slot] != color) { slot = (slot + 1) & (_colors.size() - 1); }
+
+        return _indices[slot];
+    }
+
+    std::vector<Uint32> Colors() const {
+        std::vector<Uint32> colors;
+        std::copy_if(_colors.begin(), _colors.end(), std::back_inserter(colors), [](const Uint32 color) { return color != NO_COLOR; });
+        return colors;
+    }
+};
+
+// Every colour of image, sorted, or nothing when there are more than maxColors
+static std::optional<std::vector<Uint32>> ExactPalette(const ConstImageView& image, const int maxColors, const int threads) {
+
+    std::vector<ColorTable> tables(StripCount(image.resolution.height, threads));
+    std::atomic<bool> overflowed = false;
+
+    ForEachStrip(image.resolution.height, threads, [&](const int begin, const int end, const int strip) {
+
+        ColorTable& table = tables[strip];
+        std::vector<MyByte> scratch;
+
+        for (int y = begin; y < end && !overflowed; ++y) {
+
+            const Ubyte* row = BgraRow(image, y, scratch);
+
+            // Screens are mostly runs of one colour, only look up where the colour changes
+            Uint32 last = NO_COLOR;
+
+            for (int x = 0; x < image.resolution.width; ++x) {
+
+                const Uint32 color = ColorAt(row, x);
+                if (color == last) { continue; }
+                last = color;
+
+                if (table.Insert(color) && table.Size() > maxColors) {
+                    overflowed = true;
+                    return;
+                }
+            }
+        }
+    });
+
+    if (overflowed) { return std::nullopt; }
+
+    ColorTable merged;
+
+    for (const ColorTable& table : tables) {
+        for (const Uint32 color : table.Colors()) {
+            if (merged.Insert(color) && merged.Size() > maxColors) { return std::nullopt; }
+        }
+    }
+
+    std::vector<Uint32> palette = merged.Colors();
+    std::sort(palette.begin(), palette.end());
+
+    return palette;
+}
+
+/* ------------------------- */
+
+/* ----- Octree Palette ----- */
+
+// Pixels that fell into one histogram bin, and the sums of their channels for the mean
+struct Bin {
+    Uint64 count = 0;
+    Uint64 blue = 0;
+    Uint64 green = 0;
+    Uint64 red = 0;
+
+    void Add(const Bin& other) {
+        count += other.count;
+        blue += other.blue;
+        green += other.green;
+        red += other.red;
+    }
+
+    Uint32 Mean() const {
+        const auto mean = [this](const Uint64 sum) { return static_cast<Uint32>((sum + count / 2) / count); };
+        return mean(red) << 16 | mean(green) << 8 | mean(blue);
+    }
+};
+
+static std::vector<Bin> Histogram(const ConstImageView& image, const int threads) {
+
+    std::vector<std::vector<Bin>> strips(StripCount(image.resolution.height, threads));
+
+    ForEachStrip(image.resolution.height, threads, [&](const int begin, const int end, const int strip) {
+
+        std::vector<Bin>& bins = strips[strip];
+        bins.resize(HISTOGRAM_BINS);
+
+        std::vector<MyByte> scratch;
+
+        for (int y = begin; y < end; ++y) {
+
+            const Ubyte* row = BgraRow(image, y, scratch);
+
+            for (int x = 0; x < image.resolution.width; ++x) {
+
+                const Uint32 color = ColorAt(row, x);
+                Bin& bin = bins[BinOf(color)];
+
+                ++bin.count;
+                bin.blue += Blue(color);
+                bin.green += Green(color);
+                bin.red += Red(color);
+            }
+        }
+    });
+
+    std::vector<Bin> bins = std::move(strips[0]);
+
+    for (size_t strip = 1; strip < strips.size(); ++strip) {
+        for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) { bins[bin].Add(strips[strip][bin]); }
+    }
+
+    return bins;
+}
+
+// Octree node at level holding bin, each level keeps one more bit of every channel.
+// Level HISTOGRAM_BITS is the bin itself
+static inline Uint32 NodeAt(const Uint32 bin, const int level) {
+
+    const int shift = HISTOGRAM_BITS - level;
+    const Uint32 mask = (1u << level) - 1;
+
+    const Uint32 red = (bin >> (2 * HISTOGRAM_BITS + shift)) & mask;
+    const Uint32 green = (bin >> (HISTOGRAM_BITS + shift)) & mask;
+    const Uint32 blue = (bin >> shift) & mask;
+
+    return red << (2 * level) | green << level | blue;
+}
+
+// Parent of a node at level, one level up
+static inline Uint32 ParentOf(const Uint32 node, const int level) {
+
+    const Uint32 mask = (1u << level) - 1;
+
+    const Uint32 red = (node >> (2 * level)) >> 1;
+    const Uint32 green = ((node >> level) & mask) >> 1;
+    const Uint32 blue = (node & mask) >> 1;
+
+    return red << (2 * (level - 1)) | green << (level - 1) | blue;
+}
+
+// Palette index of every non empty bin, found by folding the octree's least used branches
+// into their parents until at most maxColors leaves are left
+static std::vector<int> OctreeLeaves(const std::vector<Bin>& bins, const int maxColors, int& colors) {
+
+    std::array<std::vector<Uint64>, HISTOGRAM_BITS + 1> counts;
+    std::array<std::vector<int>, HISTOGRAM_BITS + 1> leaves;
+    std::array<std::vector<bool>, HISTOGRAM_BITS + 1> folded;
+
+    for (int level = 0; level <= HISTOGRAM_BITS; ++level) {
+        counts[level].resize(1ull << (3 * level));
+        leaves[level].resize(1ull << (3 * level));
+        folded[level].resize(1ull << (3 * level));
+    }
+
+    int totalLeaves = 0;
+
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        counts[HISTOGRAM_BITS][bin] = bins[bin].count;
+        leaves[HISTOGRAM_BITS][bin] = bins[bin].count > 0;
+        totalLeaves += leaves[HISTOGRAM_BITS][bin];
+    }
+
+    // Fold from the deepest level up, the smallest branches of a level first
+    for (int level = HISTOGRAM_BITS - 1; level >= 0 && totalLeaves > maxColors; --level) {
+
+        for (size_t child = 0; child < counts[level + 1].size(); ++child) {
+            const Uint32 parent = ParentOf(static_cast<Uint32>(child), level + 1);
+            counts[level][parent] += counts[level + 1][child];
+            leaves[level][parent] += leaves[level + 1][child];
+        }
+
+        std::vector<Uint32> branches;
+        for (Uint32 node = 0; node < leaves[level].size(); ++node) {
+            if (leaves[level][node] > 1) { branches.push_back(node); }
+        }
+
+        std::stable_sort(branches.begin(), branches.end(),
+            [&](const Uint32 a, const Uint32 b) { return counts[level][a] < counts[level][b]; });
+
+        for (const Uint32 node : branches) {
+
+            if (totalLeaves <= maxColors) { break; }
+
+            totalLeaves -= leaves[level][node] - 1;
+            leaves[level][node] = 1;
+            folded[level][node] = true;
+        }
+    }
+
+    // A bin belongs to its highest folded ancestor, or is a leaf of its own
+    std::array<std::vector<int>, HISTOGRAM_BITS + 1> indices;
+    for (int level = 0; level <= HISTOGRAM_BITS; ++level) { indices[level].assign(1ull << (3 * level), -1); }
+
+    std::vector<int> leafOf(HISTOGRAM_BINS, -1);
+    colors = 0;
+
+    for (Uint32 bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+
+        if (bins[bin].count == 0) { continue; }
+
+        int level = 0;
+        while (level < HISTOGRAM_BITS && !folded[level][NodeAt(bin, level)]) { ++level; }
+
+        int& index = indices[level][NodeAt(bin, level)];
+        if (index < 0) { index = colors++; }
+
+        leafOf[bin] = index;
+    }
+
+    return leafOf;
+}
+
+static inline int Distance(const Uint32 a, const Uint32 b) {
+    const int blue = Blue(a) - Blue(b);
+    const int green = Green(a) - Green(b);
+    const int red = Red(a) - Red(b);
+    return blue * blue + green * green + red * red;
+}
+
+static Ubyte Nearest(const Uint32 color, const std::vector<Uint32>& palette) {
+
+    int nearest = 0;
+    int nearestDistance = Distance(color, palette[0]);
+
+    for (size_t index = 1; index < palette.size(); ++index) {
+        const int distance = Distance(color, palette[index]);
+        if (distance < nearestDistance) {
+            nearest = static_cast<int>(index);
+            nearestDistance = distance;
+        }
+    }
+
+    return static_cast<Ubyte>(nearest);
+}
+
+// Palette entry closest to each colour, in parallel
+static std::vector<Ubyte> NearestOf(const std::vector<Uint32>& colors, const std::vector<Uint32>& palette, const int threads) {
+
+    std::vector<Ubyte> nearest(colors.size());
+
+    ForEachStrip(static_cast<int>(colors.size()), threads, [&](const int begin, const int end, const int) {
+        for (int index = begin; index < end; ++index) { nearest[index] = Nearest(colors[index], palette); }
+    });
+
+    return nearest;
+}
+
+// Palette of at most maxColors colours for bins, and the palette entry every bin maps to, empty ones included
+static std::vector<Uint32> OctreePalette(const std::vector<Bin>& bins, const int maxColors, const int threads, std::vector<Ubyte>& lookup) {
+
+    int colors = 0;
+    const std::vector<int> leafOf = OctreeLeaves(bins, maxColors, colors);
+
+    std::vector<Bin> sums(colors);
+    std::vector<Uint32> used;
+    std::vector<Uint32> means;
+
+    for (Uint32 bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        if (leafOf[bin] < 0) { continue; }
+
+        sums[leafOf[bin]].Add(bins[bin]);
+        used.push_back(bin);
+        means.push_back(bins[bin].Mean());
+    }
+
+    std::vector<Uint32> palette(colors);
+    std::transform(sums.begin(), sums.end(), palette.begin(), [](const Bin& sum) { return sum.Mean(); });
+
+    // k-means over the bins, moving each entry to the mean of the bins now closest to it
+    for (int pass = 0; pass < KMEANS_PASSES; ++pass) {
+
+        const std::vector<Ubyte> nearest = NearestOf(means, palette, threads);
+
+        std::fill(sums.begin(), sums.end(), Bin {});
+        for (size_t index = 0; index < used.size(); ++index) { sums[nearest[index]].Add(bins[used[index]]); }
+
+        for (int index = 0; index < colors; ++index) {
+            if (sums[index].count > 0) { palette[index] = sums[index].Mean(); }
+        }
+    }
+
+    // Dithering can push pixels into bins the image never filled, so every bin needs an entry
+    std::vector<Uint32> binColors(HISTOGRAM_BINS);
+
+    for (Uint32 bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+
+        if (bins[bin].count > 0) {
+            binColors[bin] = bins[bin].Mean();
+            continue;
+        }
+
+        // Middle of an empty bin
+        const Uint32 half = 1u << (7 - HISTOGRAM_BITS);
+        const Uint32 red = (bin >> (2 * HISTOGRAM_BITS)) << (8 - HISTOGRAM_BITS) | half;
+        const Uint32 green = ((bin >> HISTOGRAM_BITS) & 0x1F) << (8 - HISTOGRAM_BITS) | half;
+        const Uint32 blue = (bin & 0x1F) << (8 - HISTOGRAM_BITS) | half;
+
+        binColors[bin] = red << 16 | green << 8 | blue;
+    }
+
+    lookup = NearestOf(binColors, palette, threads);
+
+    return palette;
+}
+
+/* -------------------------- */
+
+/* ----- Quantisation ----- */
+
+// Threshold of each position of an 8x8 tile, 0 - 63
+static constexpr std::array<std::array<int, BAYER_SIZE>, BAYER_SIZE> BAYER_MATRIX { {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+} };
+
+IndexedImage Quantize(const ConstImageView& image, const QuantizeOptions& options) {
+
+    IndexedImage quantized;
+
+    if (BytesPerSample(image.format) != 1 || !CanConvert(image.format, PixelFormat::BGRA32)) { return quantized; }
+
+    const Resolution& resolution = image.resolution;
+    const int maxColors = std::clamp(options.maxColors, 1, MAX_PALETTE_COLORS);
+
+    quantized.indices = ImageBuffer(resolution, PixelFormat::Gray8);
+    const ImageView indices = quantized.indices.View();
+
+    if (resolution.width <= 0 || resolution.height <= 0) { return quantized; }
+
+    // Most screens fit in the palette as they are
+    if (std::optional<std::vector<Uint32>> exact = ExactPalette(image, maxColors, options.threads)) {
+
+        quantized.palette = std::move(*exact);
+        quantized.exact = true;
+
+        ColorTable table;
+        for (size_t index = 0; index < quantized.palette.size(); ++index) {
+            table.Insert(quantized.palette[index], static_cast<Ubyte>(index));
+        }
+
+        ForEachStrip(resolution.height, options.threads, [&](const int begin, const int end, const int) {
+
+            std::vector<MyByte> scratch;
+
+            for (int y = begin; y < end; ++y) {
+
+                const Ubyte* row = BgraRow(image, y, scratch);
+                Ubyte* indexRow = reinterpret_cast<Ubyte*>(indices.Row(y));
+
+                Uint32 last = NO_COLOR;
+                Ubyte lastIndex = 0;
+
+                for (int x = 0; x < resolution.width; ++x) {
+
+                    const Uint32 color = ColorAt(row, x);
+
+                    if (color != last) {
+                        last = color;
+                        lastIndex = table.Find(color);
+                    }
+
+                    indexRow[x] = lastIndex;
+                }
+            }
+        });
+
+        return quantized;
+    }
+
+    std::vector<Ubyte> lookup;
+    quantized.palette = OctreePalette(Histogram(image, options.threads), maxColors, options.threads, lookup);
+
+    // Dither by about the spacing of the palette's colours, were they spread evenly over the cube
+    const int spread = static_cast<int>(256 / std::cbrt(static_cast<double>(quantized.palette.size())));
+
+    ForEachStrip(resolution.height, options.threads, [&](const int begin, const int end, const int) {
+
+        std::vector<MyByte> scratch;
+
+        for (int y = begin; y < end; ++y) {
+
+            const Ubyte* row = BgraRow(image, y, scratch);
+            Ubyte* indexRow = reinterpret_cast<Ubyte*>(indices.Row(y));
+
+            if (!options.dither) {
+                for (int x = 0; x < resolution.width; ++x) { indexRow[x] = lookup[BinOf(ColorAt(row, x))]; }
+                continue;
+            }
+
+            const std::array<int, BAYER_SIZE>& thresholds = BAYER_MATRIX[y % BAYER_SIZE];
+
+            for (int x = 0; x < resolution.width; ++x) {
+
+                // Centred on 0, from -spread / 2 to just under spread / 2
+                const int offset = ((2 * thresholds[x % BAYER_SIZE] + 1 - BAYER_SIZE * BAYER_SIZE) * spread) / (2 * BAYER_SIZE * BAYER_SIZE);
+                const auto dithered = [offset](const int value) { return static_cast<Uint32>(std::clamp(value + offset, 0, 255)); };
+
+                const Uint32 color = ColorAt(row, x);
+                const Uint32 ditheredColor = dithered(Red(color)) << 16 | dithered(Green(color)) << 8 | dithered(Blue(color));
+
+                indexRow[x] = lookup[BinOf(ditheredColor)];
+            }
+        }
+    });
+
+    return quantized;
+}
+
+/* ------------------------ */
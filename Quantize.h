@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Convert.h"
+
+// Most colours an 8-bit indexed image can have
+constexpr const int MAX_PALETTE_COLORS = 256;
+
+/*----------Colour Quantisation----------*/
+
+struct QuantizeOptions {
+    int maxColors = MAX_PALETTE_COLORS;
+
+    // Ordered dithering, only applied when the image has more colours than the palette
+    bool dither = false;
+
+    // 0 uses every core
+    int threads = 0;
+};
+
+// Image of palette indices, indices is Gray8 in layout only, each byte is an entry of palette.
+// Palette entries are 0x00RRGGBB like a bitmap's, alpha is dropped
+struct IndexedImage {
+    ImageBuffer indices {};
+    std::vector<Uint32> palette {};
+
+    // Whether palette holds every colour of the source, nothing was approximated
+    bool exact = false;
+};
+
+// Reduce an 8-bit image to at most options.maxColors colours. Images with few enough colours, which
+// screens usually are, keep them exactly. Otherwise an octree over a 15-bit histogram picks the palette,
+// which a couple of k-means passes then refine. Empty for deep colour images
+IndexedImage Quantize(const ConstImageView& image, const QuantizeOptions& options = {});
+
+/*---------------------------------------*/
@@ -0,0 +1,124 @@
+#include "SaveQueue.h"
+
+/* ----- Save Queue ----- */
+
+SaveQueue::SaveQueue(const SaveQueueOptions& options) : _options(options) {
+
+    const int threads = ThreadCount(options.threads);
+    _writers.reserve(threads);
+
+    for (int writer = 0; writer < threads; ++writer) { _writers.emplace_back(&SaveQueue::Write, this); }
+}
+
+SaveQueue::~SaveQueue() {
+
+    {
+        std::lock_guard lock(_mutex);
+        _closing = true;
+    }
+
+    _jobAdded.notify_all();
+
+    for (std::thread& writer : _writers) { writer.join(); }
+}
+
+bool SaveQueue::HasRoom(const size_t size) const {
+
+    if (_jobs.empty() && _writing == 0) { return true; }
+
+    // Only waiting frames count towards the frame limit, the bytes of those being written still count
+    if (_jobs.size() >= std::max<size_t>(_options.maxFrames, 1)) { return false; }
+    return _options.maxBytes == 0 || _bytes + size <= _options.maxBytes;
+}
+
+bool SaveQueue::Push(ImageBuffer&& frame, const FileFormat format, std::string filename) {
+
+    const size_t size = frame.Pixels().size();
+
+    // Dropped frames are freed once the lock is let go, so writers aren't kept waiting on it
+    std::vector<Job> dropped;
+    std::unique_lock lock(_mutex);
+
+    switch (_options.policy) {
+    case QueueFullPolicy::Block:
+        _jobDone.wait(lock, [this, size]() { return HasRoom(size); });
+        break;
+    case QueueFullPolicy::DropOldest:
+        while (!HasRoom(size) && !_jobs.empty()) {
+            _bytes -= _jobs.front().frame.Pixels().size();
+            dropped.push_back(std::move(_jobs.front()));
+            _jobs.pop_front();
+        }
+        break;
+    default:
+        break;
+    }
+
+    _counts.dropped += dropped.size();
+
+    // Also when the frames being written take too many bytes, and none are left waiting to drop
+    if (!HasRoom(size)) {
+        ++_counts.dropped;
+        return false;
+    }
+
+    _jobs.push_back({ std::move(frame), format, std::move(filename) });
+    _bytes += size;
+
+    _jobAdded.notify_one();
+    return true;
+}
+
+void SaveQueue::Write() {
+
+    std::unique_lock lock(_mutex);
+
+    while (true) {
+
+        _jobAdded.wait(lock, [this]() { return _closing || !_jobs.empty(); });
+
+        // Closing, and everything taken has been handed out
+        if (_jobs.empty()) { return; }
+
+        Job job = std::move(_jobs.front());
+        _jobs.pop_front();
+        ++_writing;
+
+        lock.unlock();
+
+        const bool saved = ScreenCapture::SaveToFile(job.frame.View(), job.format, job.filename);
+
+        const size_t size = job.frame.Pixels().size();
+        job.frame = ImageBuffer();
+
+        lock.lock();
+
+        --_writing;
+        _bytes -= size;
+
+        if (saved) { ++_counts.saved; }
+        else {
+            ++_counts.failed;
+            _errors.push_back({ std::move(job.filename), job.format });
+        }
+
+        _jobDone.notify_all();
+    }
+}
+
+void SaveQueue::Flush() {
+    std::unique_lock lock(_mutex);
+    _jobDone.wait(lock, [this]() { return _jobs.empty() && _writing == 0; });
+}
+
+SaveQueueCounts SaveQueue::Counts() {
+    std::lock_guard lock(_mutex);
+    return _counts;
+}
+
+std::vector<SaveError> SaveQueue::TakeErrors() {
+    std::lock_guard lock(_mutex);
+    return std::exchange(_errors, {});
+}
+
+/* ---------------------- */
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <condition_variable>
+
+#include "Capture.h"
+#include "Parallel.h"
+
+/*----------Asynchronous Saving----------*/
+
+// What Push does with a frame when the queue is full
+enum class QueueFullPolicy {
+    Block,       // Wait for a writer to finish a frame, capture slows to the disk's pace
+    DropOldest,  // Throw away the longest waiting frames to make room
+    DropNewest   // Turn the new frame away, it stays with the caller
+};
+
+struct SaveQueueOptions {
+    // Frames waiting for a writer, at least 1. Frames being written don't count, so however many
+    // writers there are DropOldest always has a waiting frame to drop once this is reached
+    size_t maxFrames = 8;
+
+    // Bytes of pixels held, waiting and being written. 0 leaves only the frame limit. A frame is
+    // always taken when the queue holds nothing, however large, and turned away under DropOldest
+    // when the frames being written already take too much
+    size_t maxBytes = 256 * 1024 * 1024;
+
+    QueueFullPolicy policy = QueueFullPolicy::Block;
+
+    // Background writers, each encodes and writes one frame at a time. 0 uses one per core
+    int threads = 1;
+};
+
+// A frame that couldn't be encoded or written in full
+struct SaveError {
+    std::string filename;
+    FileFormat format = FileFormat::BMP;
+};
+
+// Totals since the queue was made
+struct SaveQueueCounts {
+    Uint64 saved = 0;
+    Uint64 failed = 0;
+    Uint64 dropped = 0;
+};
+
+// Saves frames with ScreenCapture::SaveToFile on background threads, so a slow disk holds up
+// the writers rather than capture. Frames are moved in, never copied, and the memory they
+// take is bounded by the options. Destroying the queue waits for every frame it took
+class SaveQueue {
+
+private:
+
+    struct Job {
+        ImageBuffer frame;
+        FileFormat format = FileFormat::BMP;
+        std::string filename;
+    };
+
+    SaveQueueOptions _options {};
+
+    std::mutex _mutex;
+    std::condition_variable _jobAdded;  // Writers wait on it for work
+    std::condition_variable _jobDone;   // Push waits on it for room, Flush for the queue to empty
+
+    std::deque<Job> _jobs {};
+    int _writing = 0;
+    size_t _bytes = 0;
+    bool _closing = false;
+
+    SaveQueueCounts _counts {};
+    std::vector<SaveError> _errors {};
+
+    std::vector<std::thread> _writers {};
+
+    // Whether a frame of size bytes fits, call with _mutex held
+    bool HasRoom(const size_t size) const;
+
+    // Writer thread, runs until the queue closes and is empty
+    void Write();
+
+public:
+
+    SaveQueue(const SaveQueueOptions& options = {});
+
+    SaveQueue(const SaveQueue&) = delete;
+    SaveQueue& operator=(const SaveQueue&) = delete;
+
+    ~SaveQueue();
+
+    // Queue frame to be saved in format, the format's extension is added to filename when missing.
+    // False when the policy turned it away, frame is then left as it was
+    bool Push(ImageBuffer&& frame, const FileFormat format, std::string filename);
+
+    // Wait until every frame pushed so far is written or has failed
+    void Flush();
+
+    SaveQueueCounts Counts();
+
+    // Frames that failed since the last call
+    std::vector<SaveError> TakeErrors();
+};
+
+/*---------------------------------------*/
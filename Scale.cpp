@@ -25,88 +25,1301 @@ ConstPixel GetPixel(const PixelData& data, const size_t index, const bool isAbso
     return ConstPixel{ data }.subspan(idx, BYTES_PER_PIXEL);
 }
 
-void AssignPixel(Pixel& assignee, const ConstPixel& other) {
+Thing SubtractPixel(const ConstPixel& subFrom, const ConstPixel& sub) {
+    Thing t;
     for (size_t channel = 0; channel < BYTES_PER_PIXEL; ++channel) {
-        assignee[channel] = other[channel];
+        t[channel] = subFrom[channel] - sub[channel];
+    }
+    return t;
+}
+
+Neighbors FindDerivatives(const bool xDir, const Resolution& res, const PixelData& data, const Neighbors& neighbors) {
+
+    static const Thing EmptyPixel = { 0, 0, 0, 0 };
+
+    Neighbors derivatives {};
+
+    int index = 0;
+
+    std::for_each(neighbors.begin(), neighbors.end(), [&](const auto& pixelAndPos) {
+
+        const auto& [pixelX, pixelY] = pixelAndPos.second;
+        const int X_MAX = res.width - 1;
+        const int Y_MAX = res.height - 1;
+
+        const int MAX = xDir ? X_MAX : Y_MAX;
+        const int axis = xDir ? pixelX : pixelY;
+
+        const int xChange = xDir ? 1 : 0;
+        const int yChange = xDir ? 0 : 1;
+
+        const ConstPixel nextPixel = (axis >= MAX) ? EmptyPixel : GetPixel(data, CoordinateToIndex(res, { pixelX + xChange, pixelY + yChange }));
+        const ConstPixel prevPixel = (axis <= 0)   ? EmptyPixel : GetPixel(data, CoordinateToIndex(res, { pixelX - xChange, pixelY - yChange }));
+
+        derivatives[index++] = { SubtractPixel(nextPixel, prevPixel), pixelAndPos.second };
+    
+    });
+    
+    return derivatives;
+
+}
+
+/* --------------------- */
+
+/* ----- Fixed Point Bilinear ----- */
+
+std::vector<BilinearTap> BilinearTaps(const int srcLength, const int destLength) {
+
+    std::vector<BilinearTap> taps(destLength);
+
+    // Distance between destination pixel centres, in source pixels, as 16.16 fixed point
+    const std::int64_t step = (static_cast<std::int64_t>(srcLength) << 16) / destLength;
+    const std::int64_t lastPosition = static_cast<std::int64_t>(srcLength - 1) << 16;
+
+    std::int64_t position = step / 2 - (1 << 15);
+
+    for (BilinearTap& tap : taps) {
+
+        const std::int64_t clamped = std::clamp<std::int64_t>(position, 0, lastPosition);
+        const int fraction = clamped & 0xFFFF;
+
+        tap.low = static_cast<int>(clamped >> 16);
+        tap.high = std::min(tap.low + 1, srcLength - 1);
+
+        // Round the 16 bit fraction down to the weight precision
+        tap.weight = (fraction + (1 << (15 - BILINEAR_WEIGHT_BITS))) >> (16 - BILINEAR_WEIGHT_BITS);
+
+        position += step;
+    }
+
+    return taps;
+}
+
+Uint32 LoadPixel(const Ubyte* pixel) {
+    Uint32 value;
+    std::memcpy(&value, pixel, BYTES_PER_PIXEL);
+    return value;
+}
+
+Uint32 BlendBilinear(const Uint32 topLeft, const Uint32 topRight,
+    const Uint32 bottomLeft, const Uint32 bottomRight, const int xWeight, const int yWeight) {
+
+    // Each neighbor's weight, the 4 always sum to BILINEAR_ONE * BILINEAR_ONE
+    const int topLeftWeight = (BILINEAR_ONE - xWeight) * (BILINEAR_ONE - yWeight);
+    const int topRightWeight = xWeight * (BILINEAR_ONE - yWeight);
+    const int bottomLeftWeight = (BILINEAR_ONE - xWeight) * yWeight;
+    const int bottomRightWeight = xWeight * yWeight;
+
+    constexpr const int shift = 2 * BILINEAR_WEIGHT_BITS;
+    constexpr const int round = 1 << (shift - 1);
+
+#if defined(QUICKSHOT_SSE2)
+
+    const __m128i zero = _mm_setzero_si128();
+
+    // Interleave left and right neighbors channel by channel and widen to 16 bits
+    const __m128i top = _mm_unpacklo_epi8(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(topLeft), _mm_cvtsi32_si128(topRight)), zero);
+    const __m128i bottom = _mm_unpacklo_epi8(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(bottomLeft), _mm_cvtsi32_si128(bottomRight)), zero);
+
+    const __m128i topWeights = _mm_set1_epi32(topLeftWeight | (topRightWeight << 16));
+    const __m128i bottomWeights = _mm_set1_epi32(bottomLeftWeight | (bottomRightWeight << 16));
+
+    // left * leftWeight + right * rightWeight for all 4 channels at once
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(top, topWeights), _mm_madd_epi16(bottom, bottomWeights));
+    sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(round)), shift);
+
+    sum = _mm_packs_epi32(sum, sum);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+
+#else
+
+    // Channels 0 and 2 ( even ) and 1 and 3 ( odd ) each share a 64 bit word in 32 bit lanes
+    constexpr const Uint64 laneMask = 0x000000FF000000FF;
+    constexpr const Uint64 laneRound = (static_cast<Uint64>(round) << 32) | round;
+
+    const auto spread = [](const Uint32 pixel) {
+        return (static_cast<Uint64>(pixel & 0x000000FF)) | (static_cast<Uint64>(pixel & 0x00FF0000) << 16);
+    };
+
+    const auto blend = [&](const int offset) {
+        const Uint64 sum = spread(topLeft >> offset) * topLeftWeight + spread(topRight >> offset) * topRightWeight +
+            spread(bottomLeft >> offset) * bottomLeftWeight + spread(bottomRight >> offset) * bottomRightWeight;
+
+        const Uint64 lanes = ((sum + laneRound) >> shift) & laneMask;
+        return static_cast<Uint32>(lanes | (lanes >> 16));
+    };
+
+    return blend(0) | (blend(8) << 8);
+
+#endif
+
+}
+
+Uint64 LoadPixel(const Ushort* pixel) {
+    Uint64 value;
+    std::memcpy(&value, pixel, sizeof(value));
+    return value;
+}
+
+Uint64 BlendBilinear(const Uint64 topLeft, const Uint64 topRight,
+    const Uint64 bottomLeft, const Uint64 bottomRight, const int xWeight, const int yWeight) {
+
+    const int topLeftWeight = (BILINEAR_ONE - xWeight) * (BILINEAR_ONE - yWeight);
+    const int topRightWeight = xWeight * (BILINEAR_ONE - yWeight);
+    const int bottomLeftWeight = (BILINEAR_ONE - xWeight) * yWeight;
+    const int bottomRightWeight = xWeight * yWeight;
+
+    constexpr const int shift = 2 * BILINEAR_WEIGHT_BITS;
+    constexpr const int round = 1 << (shift - 1);
+
+#if defined(QUICKSHOT_SSE2)
+
+    // Full range samples don't fit signed 16-bit lanes, so blend them offset by -32768.
+    // The weights always sum to BILINEAR_ONE * BILINEAR_ONE, so the offset comes back out exactly
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    const __m128i top = _mm_xor_si128(_mm_unpacklo_epi16(_mm_set_epi64x(0, topLeft), _mm_set_epi64x(0, topRight)), bias);
+    const __m128i bottom = _mm_xor_si128(_mm_unpacklo_epi16(_mm_set_epi64x(0, bottomLeft), _mm_set_epi64x(0, bottomRight)), bias);
+
+    const __m128i topWeights = _mm_set1_epi32(topLeftWeight | (topRightWeight << 16));
+    const __m128i bottomWeights = _mm_set1_epi32(bottomLeftWeight | (bottomRightWeight << 16));
+
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(top, topWeights), _mm_madd_epi16(bottom, bottomWeights));
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(round)), shift);
+
+    Uint64 blended;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&blended), _mm_xor_si128(_mm_packs_epi32(sum, sum), bias));
+    return blended;
+
+#else
+
+    Uint64 blended = 0;
+
+    for (int channel = 0; channel < BYTES_PER_PIXEL; ++channel) {
+        const int offset = 16 * channel;
+        const Uint32 sum = ((topLeft >> offset) & 0xFFFF) * topLeftWeight + ((topRight >> offset) & 0xFFFF) * topRightWeight +
+            ((bottomLeft >> offset) & 0xFFFF) * bottomLeftWeight + ((bottomRight >> offset) & 0xFFFF) * bottomRightWeight;
+
+        blended |= static_cast<Uint64>((sum + round) >> shift) << offset;
+    }
+
+    return blended;
+
+#endif
+
+}
+
+template <int Channels, typename Sample>
+void BilinearRow(const Sample* topRow, const Sample* bottomRow, const std::vector<BilinearTap>& xTaps,
+    const int yWeight, const int destBegin, const int destEnd, Sample* scaledRow) {
+
+    for (int destX = destBegin; destX < destEnd; ++destX) {
+
+        const BilinearTap& xTap = xTaps[destX];
+
+        const size_t low = static_cast<size_t>(xTap.low) * Channels;
+        const size_t high = static_cast<size_t>(xTap.high) * Channels;
+
+        // 4 channels fit a single word, blend them all at once
+        if constexpr (Channels == 4) {
+            const auto blended = BlendBilinear(LoadPixel(topRow + low), LoadPixel(topRow + high),
+                LoadPixel(bottomRow + low), LoadPixel(bottomRow + high), xTap.weight, yWeight);
+
+            std::memcpy(scaledRow + destX * Channels, &blended, sizeof(blended));
+        }
+        else {
+            // Same weights and rounding as BlendBilinear, one channel at a time
+            const int topLeftWeight = (BILINEAR_ONE - xTap.weight) * (BILINEAR_ONE - yWeight);
+            const int topRightWeight = xTap.weight * (BILINEAR_ONE - yWeight);
+            const int bottomLeftWeight = (BILINEAR_ONE - xTap.weight) * yWeight;
+            const int bottomRightWeight = xTap.weight * yWeight;
+
+            constexpr const int shift = 2 * BILINEAR_WEIGHT_BITS;
+            constexpr const int round = 1 << (shift - 1);
+
+            for (int channel = 0; channel < Channels; ++channel) {
+                const int sum = topRow[low + channel] * topLeftWeight + topRow[high + channel] * topRightWeight +
+                    bottomRow[low + channel] * bottomLeftWeight + bottomRow[high + channel] * bottomRightWeight;
+
+                scaledRow[destX * Channels + channel] = static_cast<Sample>((sum + round) >> shift);
+            }
+        }
+    }
+}
+
+/* -------------------------------- */
+
+/* ----- Linear Light ----- */
+
+const std::array<Ushort, 256>& SrgbToLinear() {
+
+    static const std::array<Ushort, 256> table = [] {
+
+        std::array<Ushort, 256> linear {};
+
+        for (int value = 0; value < 256; ++value) {
+            const double srgb = value / 255.0;
+            const double light = srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
+            linear[value] = static_cast<Ushort>(std::lround(light * LINEAR_MAX));
+        }
+
+        return linear;
+    }();
+
+    return table;
+}
+
+const std::array<Ubyte, LINEAR_MAX + 1>& LinearToSrgb() {
+
+    static const std::array<Ubyte, LINEAR_MAX + 1> table = [] {
+
+        std::array<Ubyte, LINEAR_MAX + 1> srgb {};
+
+        for (int value = 0; value <= LINEAR_MAX; ++value) {
+            const double light = value / (double)LINEAR_MAX;
+            const double encoded = light <= 0.0031308 ? light * 12.92 : 1.055 * std::pow(light, 1 / 2.4) - 0.055;
+            srgb[value] = static_cast<Ubyte>(std::lround(encoded * 255));
+        }
+
+        return srgb;
+    }();
+
+    return table;
+}
+
+void ToLinearRow(const Ubyte* row, Ushort* linearRow, const size_t length, const int alphaSample) {
+
+    const std::array<Ushort, 256>& toLinear = SrgbToLinear();
+
+    if (alphaSample < 0) {
+        for (size_t index = 0; index < length; ++index) {
+            linearRow[index] = toLinear[row[index]];
+        }
+        return;
+    }
+
+    for (size_t index = 0; index < length; index += BYTES_PER_PIXEL) {
+        for (int sample = 0; sample < BYTES_PER_PIXEL; ++sample) {
+
+            // Alpha isn't gamma encoded, only stretch it to the same range
+            linearRow[index + sample] = sample == alphaSample ?
+                static_cast<Ushort>((row[index + sample] * LINEAR_MAX + 127) / 255) : toLinear[row[index + sample]];
+        }
+    }
+}
+
+void ToSrgbRow(const Ushort* linearRow, Ubyte* row, const size_t length, const int alphaSample) {
+
+    const std::array<Ubyte, LINEAR_MAX + 1>& toSrgb = LinearToSrgb();
+
+    if (alphaSample < 0) {
+        for (size_t index = 0; index < length; ++index) {
+            row[index] = toSrgb[linearRow[index]];
+        }
+        return;
+    }
+
+    for (size_t index = 0; index < length; index += BYTES_PER_PIXEL) {
+        for (int sample = 0; sample < BYTES_PER_PIXEL; ++sample) {
+            row[index + sample] = sample == alphaSample ?
+                static_cast<Ubyte>((linearRow[index + sample] * 255 + LINEAR_MAX / 2) / LINEAR_MAX) : toSrgb[linearRow[index + sample]];
+        }
+    }
+}
+
+/* ------------------------ */
+
+/* ----- Integer Zoom ----- */
+
+template <int Channels>
+void ReplicateRow(const Ubyte* sourceRow, const int factor, const int destBegin, const int destEnd, Ubyte* scaledRow) {
+
+    const auto copyPixel = [&](const int destX) {
+        std::memcpy(scaledRow + destX * Channels, sourceRow + (destX / factor) * Channels, Channels);
+    };
+
+    // Spans can start or end part way through a source pixel's copies
+    const int wholeBegin = std::min((destBegin + factor - 1) / factor, destEnd / factor);
+    const int wholeEnd = destEnd / factor;
+
+    for (int destX = destBegin; destX < std::min(wholeBegin * factor, destEnd); ++destX) {
+        copyPixel(destX);
+    }
+
+    int srcX = wholeBegin;
+
+#if defined(QUICKSHOT_SSE2)
+
+    // 4 source pixels at a time, spread across vector stores
+    if constexpr (Channels == 4) {
+        if (factor == 2) {
+            for (; srcX + 4 <= wholeEnd; srcX += 4) {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceRow + srcX * Channels));
+                __m128i* scaled = reinterpret_cast<__m128i*>(scaledRow + srcX * 2 * Channels);
+
+                _mm_storeu_si128(scaled, _mm_unpacklo_epi32(pixels, pixels));
+                _mm_storeu_si128(scaled + 1, _mm_unpackhi_epi32(pixels, pixels));
+            }
+        }
+        else if (factor == 4) {
+            for (; srcX + 4 <= wholeEnd; srcX += 4) {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceRow + srcX * Channels));
+                __m128i* scaled = reinterpret_cast<__m128i*>(scaledRow + srcX * 4 * Channels);
+
+                _mm_storeu_si128(scaled, _mm_shuffle_epi32(pixels, 0x00));
+                _mm_storeu_si128(scaled + 1, _mm_shuffle_epi32(pixels, 0x55));
+                _mm_storeu_si128(scaled + 2, _mm_shuffle_epi32(pixels, 0xAA));
+                _mm_storeu_si128(scaled + 3, _mm_shuffle_epi32(pixels, 0xFF));
+            }
+        }
+    }
+
+#endif
+
+    for (; srcX < wholeEnd; ++srcX) {
+
+        const Ubyte* pixel = sourceRow + srcX * Channels;
+        Ubyte* scaled = scaledRow + srcX * factor * Channels;
+
+        for (int copy = 0; copy < factor; ++copy) {
+            std::memcpy(scaled + copy * Channels, pixel, Channels);
+        }
+    }
+
+    for (int destX = std::max(wholeEnd * factor, destBegin); destX < destEnd; ++destX) {
+        copyPixel(destX);
+    }
+}
+
+/* ------------------------ */
+
+/* ----- Area Averaging ----- */
+
+AreaTaps AreaFootprints(const int srcLength, const int destLength) {
+
+    AreaTaps taps;
+    taps.footprints.resize(destLength);
+
+    // Work in units of 1 / destLength source pixels so every boundary is a whole number
+    for (int destIndex = 0; destIndex < destLength; ++destIndex) {
+
+        const std::int64_t start = static_cast<std::int64_t>(destIndex) * srcLength;
+        const std::int64_t end = start + srcLength;
+
+        AreaFootprint& footprint = taps.footprints[destIndex];
+        footprint.first = static_cast<int>(start / destLength);
+        footprint.count = static_cast<int>((end - 1) / destLength) - footprint.first + 1;
+        footprint.weights = taps.weights.size();
+
+        for (int srcIndex = footprint.first; srcIndex < footprint.first + footprint.count; ++srcIndex) {
+            const std::int64_t pixelStart = static_cast<std::int64_t>(srcIndex) * destLength;
+            const std::int64_t pixelEnd = pixelStart + destLength;
+
+            taps.weights.push_back(static_cast<Uint32>(std::min(end, pixelEnd) - std::max(start, pixelStart)));
+        }
+    }
+
+    return taps;
+}
+
+void AccumulateRow(Ushort* sums, const Ubyte* row, const size_t length) {
+
+    size_t index = 0;
+
+#if defined(QUICKSHOT_SSE2)
+
+    const __m128i zero = _mm_setzero_si128();
+
+    // Widen 16 bytes at a time and add them to the running sums
+    for (; index + 16 <= length; index += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + index));
+
+        __m128i* low = reinterpret_cast<__m128i*>(sums + index);
+        __m128i* high = reinterpret_cast<__m128i*>(sums + index + 8);
+
+        _mm_storeu_si128(low, _mm_add_epi16(_mm_loadu_si128(low), _mm_unpacklo_epi8(bytes, zero)));
+        _mm_storeu_si128(high, _mm_add_epi16(_mm_loadu_si128(high), _mm_unpackhi_epi8(bytes, zero)));
+    }
+
+#endif
+
+    for (; index < length; ++index) {
+        sums[index] += row[index];
+    }
+}
+
+void AccumulateRow(Uint32* sums, const Ushort* row, const size_t length) {
+
+    size_t index = 0;
+
+#if defined(QUICKSHOT_SSE2)
+
+    const __m128i zero = _mm_setzero_si128();
+
+    // Widen 8 samples at a time
+    for (; index + 8 <= length; index += 8) {
+        const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + index));
+
+        __m128i* low = reinterpret_cast<__m128i*>(sums + index);
+        __m128i* high = reinterpret_cast<__m128i*>(sums + index + 4);
+
+        _mm_storeu_si128(low, _mm_add_epi32(_mm_loadu_si128(low), _mm_unpacklo_epi16(samples, zero)));
+        _mm_storeu_si128(high, _mm_add_epi32(_mm_loadu_si128(high), _mm_unpackhi_epi16(samples, zero)));
+    }
+
+#endif
+
+    for (; index < length; ++index) {
+        sums[index] += row[index];
+    }
+}
+
+template <int Channels, typename Sample>
+void AreaRow(const Sample* const* rows, const Uint32* rowWeights, const int rowCount, const AreaTaps& xTaps,
+    const Uint64 area, Uint32* columnSums, const int destBegin, const int destEnd, Sample* scaledRow) {
+
+    // Only the source columns under destination columns destBegin to destEnd are read
+    const AreaFootprint& lastColumns = xTaps.footprints[destEnd - 1];
+    const size_t srcBegin = static_cast<size_t>(xTaps.footprints[destBegin].first) * Channels;
+    const size_t srcEnd = static_cast<size_t>(lastColumns.first + lastColumns.count) * Channels;
+
+    // Weighted sum of the source rows under the destination row
+    std::fill(columnSums + srcBegin, columnSums + srcEnd, 0);
+
+    for (int row = 0; row < rowCount; ++row) {
+        const Sample* sourceRow = rows[row];
+        const Uint32 weight = rowWeights[row];
+
+        for (size_t index = srcBegin; index < srcEnd; ++index) {
+            columnSums[index] += sourceRow[index] * weight;
+        }
+    }
+
+    for (int destX = destBegin; destX < destEnd; ++destX) {
+
+        const AreaFootprint& columns = xTaps.footprints[destX];
+
+        std::array<Uint64, Channels> sums {};
+
+        for (int column = 0; column < columns.count; ++column) {
+            const Uint32* columnSum = columnSums + static_cast<size_t>(columns.first + column) * Channels;
+            const Uint64 weight = xTaps.weights[columns.weights + column];
+
+            for (int channel = 0; channel < Channels; ++channel) {
+                sums[channel] += weight * columnSum[channel];
+            }
+        }
+
+        for (int channel = 0; channel < Channels; ++channel) {
+            scaledRow[destX * Channels + channel] = static_cast<Sample>((sums[channel] + area / 2) / area);
+        }
+    }
+}
+
+template <int Factor, int Channels, typename Sample, typename Sum>
+void AreaIntegerRow(const Sample* const* rows, Sum* rowSums, const int destBegin, const int destEnd, Sample* scaledRow) {
+
+    // Largest sum is 64 times the largest sample, bytes still fit 16-bit sums and deep colour 32-bit ones
+    static_assert(static_cast<Uint64>(Factor) * Factor * std::numeric_limits<Sample>::max() <= std::numeric_limits<Sum>::max());
+
+    constexpr const Uint32 area = Factor * Factor;
+    const size_t srcBegin = static_cast<size_t>(destBegin) * Factor * Channels;
+    const size_t srcLength = static_cast<size_t>(destEnd - destBegin) * Factor * Channels;
+
+    // Sum the Factor source rows vertically
+    std::fill(rowSums + srcBegin, rowSums + srcBegin + srcLength, 0);
+
+    for (int row = 0; row < Factor; ++row) {
+        AccumulateRow(rowSums + srcBegin, rows[row] + srcBegin, srcLength);
+    }
+
+    // Then Factor pixels horizontally
+    for (int destX = destBegin; destX < destEnd; ++destX) {
+
+        const Sum* pixelSums = rowSums + static_cast<size_t>(destX) * Factor * Channels;
+        Sample* scaledPixel = scaledRow + destX * Channels;
+
+#if defined(QUICKSHOT_SSE2)
+
+        // Deep colour pixels of 4 32-bit sums fill a vector. Sums stay below 2^22 so
+        // dividing them as floats is exact
+        if constexpr (Channels == 4 && std::is_same_v<Sum, Uint32>) {
+            __m128i sum = _mm_setzero_si128();
+            for (int column = 0; column < Factor; ++column) {
+                sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixelSums + column * Channels)));
+            }
+
+            const __m128 rounded = _mm_cvtepi32_ps(_mm_add_epi32(sum, _mm_set1_epi32(area / 2)));
+            const __m128i averages = _mm_cvttps_epi32(_mm_div_ps(rounded, _mm_set1_ps(static_cast<float>(area))));
+
+            // Offset to signed so packing doesn't saturate samples above 32767
+            const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+            const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(averages, _mm_set1_epi32(0x8000)), averages);
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(scaledPixel), _mm_xor_si128(packed, bias));
+            continue;
+        }
+
+#endif
+
+        // 4 channels of 16 bits each share one word
+        if constexpr (Channels == 4 && std::is_same_v<Sum, Ushort>) {
+            Uint64 sum = 0;
+            for (int column = 0; column < Factor; ++column) {
+                Uint64 pixelSum;
+                std::memcpy(&pixelSum, pixelSums + column * Channels, sizeof(pixelSum));
+                sum += pixelSum;
+            }
+
+            for (int channel = 0; channel < Channels; ++channel) {
+                const Uint32 channelSum = (sum >> (16 * channel)) & 0xFFFF;
+                scaledPixel[channel] = static_cast<Sample>((channelSum + area / 2) / area);
+            }
+        }
+        else {
+            for (int channel = 0; channel < Channels; ++channel) {
+                Uint32 channelSum = 0;
+                for (int column = 0; column < Factor; ++column) {
+                    channelSum += pixelSums[column * Channels + channel];
+                }
+
+                scaledPixel[channel] = static_cast<Sample>((channelSum + area / 2) / area);
+            }
+        }
+    }
+}
+
+/* -------------------------- */
+
+/* ----- Row Scaler ----- */
+
+RowScaler::RowScaler(const ScaleMethod method, const Resolution& src, const Resolution& dest,
+    const bool linearLight, const PixelFormat format) : _method(method), _src(src), _dest(dest),
+    _format(format), _channels(static_cast<int>(ChannelCount(format))),
+    _sampleSize(static_cast<int>(BytesPerSample(format))), _linearLight(linearLight) {
+
+    // Linear light tables only cover 8-bit samples
+    _linearLight = _linearLight && _sampleSize == 1;
+
+    using enum ScaleMethod;
+
+    switch (_method) {
+    case NearestNeighbor: {
+
+        const double scaleX = dest.width / (double)src.width;
+        const double scaleY = dest.height / (double)src.height;
+
+        _nearestColumns.resize(dest.width);
+        for (int destX = 0; destX < dest.width; ++destX) {
+            _nearestColumns[destX] = std::min((int)(destX / scaleX), src.width - 1);
+        }
+
+        _nearestRows.resize(dest.height);
+        for (int destY = 0; destY < dest.height; ++destY) {
+            _nearestRows[destY] = std::min((int)(destY / scaleY), src.height - 1);
+        }
+
+        // Enlarging by whole numbers only repeats pixels and rows, which has a faster path
+        if (dest.width % src.width == 0 && dest.height % src.height == 0) {
+            _zoomX = dest.width / src.width;
+            _zoomY = dest.height / src.height;
+        }
+
+        break;
+    }
+    case Bilinear:
+        _xBilinear = BilinearTaps(src.width, dest.width);
+        _yBilinear = BilinearTaps(src.height, dest.height);
+        break;
+    case Area: {
+
+        // Shrinking by the same whole number on both axes has a faster path
+        const int factor = src.width / dest.width;
+        const bool isWhole = src.width == dest.width * factor && src.height == dest.height * factor;
+
+        if (isWhole && (factor == 2 || factor == 3 || factor == 4 || factor == 8)) {
+            _areaFactor = factor;
+
+            // Linear light and deep colour samples are summed in 32 bits, bytes in 16
+            if (_linearLight || _sampleSize > 1) { _columnSums.resize(SampleIndex(src.width)); }
+            else { _rowSums.resize(SampleIndex(src.width)); }
+
+            break;
+        }
+
+        _xArea = AreaFootprints(src.width, dest.width);
+        _yArea = AreaFootprints(src.height, dest.height);
+        _area = static_cast<Uint64>(src.width) * src.height;
+        _columnSums.resize(SampleIndex(src.width));
+        break;
+    }
+    default:
+        break;
+    }
+
+    // Nearest neighbor never blends so it has nothing to gain from linear light
+    _linearLight = _linearLight && _method != NearestNeighbor;
+
+    // Most source rows any destination row reads
+    int rowsNeeded = 1;
+    for (int destY = 0; destY < dest.height; ++destY) {
+        rowsNeeded = std::max(rowsNeeded, LastSourceRow(destY) - FirstSourceRow(destY) + 1);
+    }
+
+    _sourceRows.resize(rowsNeeded);
+
+    if (_linearLight) {
+        _linearRowCount = rowsNeeded;
+        _linearRows.resize(SampleIndex(src.width) * rowsNeeded);
+        _linearRowTags.assign(rowsNeeded, -1);
+        _linearRowColumns.assign(rowsNeeded, { 0, -1 });
+        _linearDestRow.resize(SampleIndex(dest.width));
+    }
+
+    if (_linearLight || _sampleSize > 1) {
+        _wideSourceRows.resize(rowsNeeded);
+    }
+
+    switch (_channels) {
+    case 1:
+        SelectKernels<1>();
+        break;
+    case 3:
+        SelectKernels<3>();
+        break;
+    default:
+        SelectKernels<4>();
+        break;
+    }
+}
+
+template <int Channels>
+void RowScaler::SelectKernels() {
+
+    using enum ScaleMethod;
+
+    switch (_method) {
+    case NearestNeighbor:
+        _byteKernel = &RowScaler::ScaleSamples<NearestNeighbor, Channels, Ubyte>;
+        _wideKernel = &RowScaler::ScaleSamples<NearestNeighbor, Channels, Ushort>;
+        break;
+    case Bilinear:
+        _byteKernel = &RowScaler::ScaleSamples<Bilinear, Channels, Ubyte>;
+        _wideKernel = &RowScaler::ScaleSamples<Bilinear, Channels, Ushort>;
+        break;
+    case Area:
+        _byteKernel = &RowScaler::ScaleSamples<Area, Channels, Ubyte>;
+        _wideKernel = &RowScaler::ScaleSamples<Area, Channels, Ushort>;
+        break;
+    default:
+        break;
+    }
+}
+
+size_t RowScaler::SampleIndex(const int pixel) const {
+    return static_cast<size_t>(pixel) * _channels;
+}
+
+size_t RowScaler::ByteIndex(const int pixel) const {
+    return SampleIndex(pixel) * _sampleSize;
+}
+
+bool RowScaler::Matches(const ScaleMethod method, const Resolution& src, const Resolution& dest,
+    const bool linearLight, const PixelFormat format) const {
+
+    // Nearest neighbor drops linear light, so it matches either way
+    const bool sameLight = _linearLight == linearLight || method == ScaleMethod::NearestNeighbor;
+    return _method == method && _src == src && _dest == dest && _format == format && sameLight;
+}
+
+void RowScaler::Reset() {
+    std::fill(_linearRowTags.begin(), _linearRowTags.end(), -1);
+}
+
+void RowScaler::Scale(const ConstImageView& source, const ImageView& dest, StatsCollector* stats) {
+
+    // Rows converted to linear light belonged to the last image
+    Reset();
+
+    for (int destY = 0; destY < _dest.height; ++destY) {
+
+        // Whole number zooms repeat each scaled row, copy it rather than scale it again
+        if (_zoomY > 1 && destY % _zoomY != 0) {
+            std::memcpy(dest.Row(destY), dest.Row(destY - 1), ByteIndex(_dest.width));
+        }
+        else {
+            ScaleRow(destY, source, reinterpret_cast<Ubyte*>(dest.Row(destY)));
+        }
+
+        if (stats != nullptr) { stats->AddRow(dest.Row(destY), _dest.width); }
+    }
+}
+
+bool RowScaler::Supports(const ScaleMethod method) {
+    using enum ScaleMethod;
+    return method == NearestNeighbor || method == Bilinear || method == Area;
+}
+
+int RowScaler::FirstSourceRow(const int destY) const {
+
+    using enum ScaleMethod;
+
+    switch (_method) {
+    case NearestNeighbor:
+        return _nearestRows[destY];
+    case Bilinear:
+        return _yBilinear[destY].low;
+    case Area:
+        return _areaFactor > 0 ? destY * _areaFactor : _yArea.footprints[destY].first;
+    default:
+        return 0;
+    }
+}
+
+int RowScaler::LastSourceRow(const int destY) const {
+
+    using enum ScaleMethod;
+
+    switch (_method) {
+    case NearestNeighbor:
+        return _nearestRows[destY];
+    case Bilinear:
+        return _yBilinear[destY].high;
+    case Area:
+        return _areaFactor > 0 ? (destY + 1) * _areaFactor - 1 :
+            _yArea.footprints[destY].first + _yArea.footprints[destY].count - 1;
+    default:
+        return 0;
+    }
+}
+
+void RowScaler::ScaleRow(const int destY, const Ubyte* const* sourceRows, Ubyte* destRow) {
+    ScaleSpan(destY, sourceRows, destRow, 0, _dest.width);
+}
+
+void RowScaler::ScaleRow(const int destY, const ConstImageView& source, Ubyte* destRow) {
+
+    const int firstRow = FirstSourceRow(destY);
+
+    for (int row = firstRow; row <= LastSourceRow(destY); ++row) {
+        _sourceRows[row - firstRow] = reinterpret_cast<const Ubyte*>(source.Row(row));
+    }
+
+    ScaleRow(destY, _sourceRows.data(), destRow);
+}
+
+void RowScaler::ScaleSpan(const int destY, const Ubyte* const* sourceRows, Ubyte* destRow,
+    const int destBegin, const int destEnd) {
+
+    const int firstRow = FirstSourceRow(destY);
+
+    // Deep colour rows are already 16-bit samples
+    if (_sampleSize > 1) {
+        for (int row = 0; row <= LastSourceRow(destY) - firstRow; ++row) {
+            _wideSourceRows[row] = reinterpret_cast<const Ushort*>(sourceRows[row]);
+        }
+
+        (this->*_wideKernel)(destY, _wideSourceRows.data(), reinterpret_cast<Ushort*>(destRow), destBegin, destEnd);
+        return;
+    }
+
+    if (!_linearLight) {
+        (this->*_byteKernel)(destY, sourceRows, destRow, destBegin, destEnd);
+        return;
+    }
+
+    // Convert the columns of the source rows the span reads to linear light. Rows shared with
+    // the previous destination row are reused when they already hold those columns
+    const size_t srcRowSize = SampleIndex(_src.width);
+    const std::pair<int, int> columns = SourceColumns(destBegin, destEnd);
+
+    const size_t spanOffset = SampleIndex(columns.first);
+    const size_t spanSize = SampleIndex(columns.second - columns.first + 1);
+
+    for (int row = 0; row <= LastSourceRow(destY) - firstRow; ++row) {
+
+        const int slot = (firstRow + row) % _linearRowCount;
+        Ushort* linearRow = _linearRows.data() + slot * srcRowSize;
+
+        const bool converted = _linearRowTags[slot] == firstRow + row &&
+            _linearRowColumns[slot].first <= columns.first && _linearRowColumns[slot].second >= columns.second;
+
+        if (!converted) {
+            ToLinearRow(sourceRows[row] + spanOffset, linearRow + spanOffset, spanSize, ChannelOrder(_format)[3]);
+            _linearRowTags[slot] = firstRow + row;
+            _linearRowColumns[slot] = columns;
+        }
+
+        _wideSourceRows[row] = linearRow;
+    }
+
+    (this->*_wideKernel)(destY, _wideSourceRows.data(), _linearDestRow.data(), destBegin, destEnd);
+    ToSrgbRow(_linearDestRow.data() + SampleIndex(destBegin), destRow + SampleIndex(destBegin),
+        SampleIndex(destEnd - destBegin), ChannelOrder(_format)[3]);
+}
+
+template <ScaleMethod Method, int Channels, typename Sample>
+void RowScaler::ScaleSamples(const int destY, const Sample* const* sourceRows, Sample* destRow,
+    const int destBegin, const int destEnd) {
+
+    using enum ScaleMethod;
+
+    if constexpr (Method == NearestNeighbor) {
+
+        // Nearest neighbor never runs in linear light, so whole number zooms only come as bytes
+        if constexpr (std::is_same_v<Sample, Ubyte>) {
+            if (_zoomX > 0) { return ReplicateRow<Channels>(sourceRows[0], _zoomX, destBegin, destEnd, destRow); }
+        }
+
+        for (int destX = destBegin; destX < destEnd; ++destX) {
+            std::memcpy(destRow + destX * Channels, sourceRows[0] + _nearestColumns[destX] * Channels,
+                sizeof(Sample) * Channels);
+        }
+    }
+    else if constexpr (Method == Bilinear) {
+
+        // A tap with the same low and high row only has one row to read
+        BilinearRow<Channels>(sourceRows[0], sourceRows[_yBilinear[destY].high - _yBilinear[destY].low],
+            _xBilinear, _yBilinear[destY].weight, destBegin, destEnd, destRow);
+    }
+    else if constexpr (Method == Area) {
+
+        // Whole number reductions sum bytes in 16 bits and deep colour in 32
+        auto* rowSums = [&] {
+            if constexpr (std::is_same_v<Sample, Ubyte>) { return _rowSums.data(); }
+            else { return _columnSums.data(); }
+        }();
+
+        switch (_areaFactor) {
+        case 2:
+            return AreaIntegerRow<2, Channels>(sourceRows, rowSums, destBegin, destEnd, destRow);
+        case 3:
+            return AreaIntegerRow<3, Channels>(sourceRows, rowSums, destBegin, destEnd, destRow);
+        case 4:
+            return AreaIntegerRow<4, Channels>(sourceRows, rowSums, destBegin, destEnd, destRow);
+        case 8:
+            return AreaIntegerRow<8, Channels>(sourceRows, rowSums, destBegin, destEnd, destRow);
+        default:
+            break;
+        }
+
+        const AreaFootprint& footprint = _yArea.footprints[destY];
+        AreaRow<Channels>(sourceRows, _yArea.weights.data() + footprint.weights, footprint.count, _xArea, _area,
+            _columnSums.data(), destBegin, destEnd, destRow);
+    }
+}
+
+std::pair<int, int> RowScaler::SourceColumns(const int destBegin, const int destEnd) const {
+
+    using enum ScaleMethod;
+
+    switch (_method) {
+    case NearestNeighbor:
+        return { _nearestColumns[destBegin], _nearestColumns[destEnd - 1] };
+    case Bilinear:
+        return { _xBilinear[destBegin].low, _xBilinear[destEnd - 1].high };
+    case Area: {
+        if (_areaFactor > 0) { return { destBegin * _areaFactor, destEnd * _areaFactor - 1 }; }
+
+        const AreaFootprint& lastColumns = _xArea.footprints[destEnd - 1];
+        return { _xArea.footprints[destBegin].first, lastColumns.first + lastColumns.count - 1 };
+    }
+    default:
+        return { 0, _src.width - 1 };
+    }
+}
+
+ScreenArea RowScaler::DestArea(const ScreenArea& sourceArea) const {
+
+    // Source footprints only move forward as the destination does, so binary search for
+    // the first destination pixel reaching the area and the first one past it
+    const auto firstAfter = [](const int length, const auto& isPast) {
+        int low = 0, high = length;
+        while (low < high) {
+            const int middle = (low + high) / 2;
+            if (isPast(middle)) { high = middle; }
+            else { low = middle + 1; }
+        }
+        return low;
+    };
+
+    const int left = firstAfter(_dest.width, [&](const int x) { return SourceColumns(x, x + 1).second >= sourceArea.left; });
+    const int right = firstAfter(_dest.width, [&](const int x) { return SourceColumns(x, x + 1).first >= sourceArea.right; });
+    const int top = firstAfter(_dest.height, [&](const int y) { return LastSourceRow(y) >= sourceArea.top; });
+    const int bottom = firstAfter(_dest.height, [&](const int y) { return FirstSourceRow(y) >= sourceArea.bottom; });
+
+    if (left >= right || top >= bottom) { return ScreenArea(); }
+
+    return { left, right, top, bottom };
+}
+
+void RowScaler::ScaleArea(const ConstImageView& source, const ImageView& dest, const ScreenArea& destArea) {
+
+    // Linear rows kept from before may belong to pixels that have since changed
+    Reset();
+
+    for (int destY = destArea.top; destY < destArea.bottom; ++destY) {
+
+        const int firstRow = FirstSourceRow(destY);
+
+        for (int row = firstRow; row <= LastSourceRow(destY); ++row) {
+            _sourceRows[row - firstRow] = reinterpret_cast<const Ubyte*>(source.Row(row));
+        }
+
+        ScaleSpan(destY, _sourceRows.data(), reinterpret_cast<Ubyte*>(dest.Row(destY)), destArea.left, destArea.right);
+    }
+}
+
+int RowScaler::MaxSourceRows() const { return static_cast<int>(_sourceRows.size()); }
+
+const Resolution& RowScaler::SourceResolution() const { return _src; }
+
+const Resolution& RowScaler::DestResolution() const { return _dest; }
+
+PixelFormat RowScaler::Format() const { return _format; }
+
+/* ---------------------- */
+
+/* ----- Streaming Scaler ----- */
+
+StreamingScaler::StreamingScaler(const ScaleMethod method, const Resolution& src, const Resolution& dest,
+    RowCallback onRow, const bool linearLight, const PixelFormat format) :
+    _rowScaler(method, src, dest, linearLight, format), _onRow(std::move(onRow)) {
+
+    // Rows are consumed as soon as the last one they need arrives, so the widest
+    // filter footprint is all that ever has to be kept
+    _ringRows = _rowScaler.MaxSourceRows();
+    _rowSize = src.width * BytesPerPixel(format);
+
+    _ring.resize(_rowSize * _ringRows);
+    _sourceRows.resize(_ringRows);
+    _destRow.resize(dest.width * BytesPerPixel(format));
+}
+
+void StreamingScaler::PushRow(ConstPixel row) {
+
+    const Resolution& src = _rowScaler.SourceResolution();
+    const Resolution& dest = _rowScaler.DestResolution();
+
+    if (_nextSourceRow >= src.height || row.size() < _rowSize) { return; }
+
+    std::memcpy(_ring.data() + (_nextSourceRow % _ringRows) * _rowSize, row.data(), _rowSize);
+    ++_nextSourceRow;
+
+    // Hand out every destination row whose source rows have all arrived
+    for (; _nextDestRow < dest.height; ++_nextDestRow) {
+
+        const int destY = _nextDestRow;
+        if (_rowScaler.LastSourceRow(destY) >= _nextSourceRow) { break; }
+
+        const int firstRow = _rowScaler.FirstSourceRow(destY);
+
+        for (int sourceRow = firstRow; sourceRow <= _rowScaler.LastSourceRow(destY); ++sourceRow) {
+            _sourceRows[sourceRow - firstRow] = _ring.data() + (sourceRow % _ringRows) * _rowSize;
+        }
+
+        _rowScaler.ScaleRow(destY, _sourceRows.data(), _destRow.data());
+        _onRow(destY, ConstPixel(reinterpret_cast<const MyByte*>(_destRow.data()), _destRow.size()));
+    }
+}
+
+bool StreamingScaler::IsComplete() const { return _nextDestRow >= _rowScaler.DestResolution().height; }
+
+void StreamingScaler::Reset() {
+    _nextSourceRow = 0;
+    _nextDestRow = 0;
+    _rowScaler.Reset();
+}
+
+const Resolution& StreamingScaler::SourceResolution() const { return _rowScaler.SourceResolution(); }
+
+const Resolution& StreamingScaler::DestResolution() const { return _rowScaler.DestResolution(); }
+
+PixelFormat StreamingScaler::Format() const { return _rowScaler.Format(); }
+
+/* ---------------------------- */
+
+/* ----- Scaler ----- */
+
+Scaler::Scaler(const ScaleMethod method, const bool linearLight) :
+    method(method), linearLight(linearLight) {}
+
+PixelData Scaler::Scale(const PixelData& sourceImage,
+    const Resolution& sourceResolution, const Resolution& destResolution) const {
+
+    // If the resolutions are the same, don't scale
+    if (sourceResolution == destResolution) [[unlikely]] {
+        return sourceImage;
+    }
+
+    return Scale(ConstImageView(sourceImage.data(), sourceResolution), destResolution).Release();
+}
+
+PixelData Scaler::Scale(const PixelData& sourceImage,
+    const Resolution& sourceResolution, const ScaleRatio& scaleRatio) const {
+
+    return Scale(sourceImage, sourceResolution, 
+        Resolution { sourceResolution.width * scaleRatio.xRatio, sourceResolution.height * scaleRatio.yRatio });
+}
+
+PixelData Scaler::Scale(const PixelData& sourceImage, const Resolution& sourceResolution, const Uint32 scalingFactor) const {
+    return Scale(sourceImage, sourceResolution, ScaleRatio(scalingFactor, scalingFactor));
+}
+
+std::vector<PixelData> Scaler::Scale(const PixelData& sourceImage,
+    const Resolution& sourceResolution, const std::vector<Resolution>& destResolutions) const {
+
+    std::vector<ImageBuffer> scaledImages = Scale(ConstImageView(sourceImage.data(), sourceResolution), destResolutions);
+
+    std::vector<PixelData> scaledPixels;
+    for (ImageBuffer& scaledImage : scaledImages) {
+        scaledPixels.push_back(scaledImage.Release());
+    }
+
+    return scaledPixels;
+}
+
+ImageBuffer Scaler::Scale(const ConstImageView& source, const Resolution& destResolution) const {
+
+    // If the resolutions are the same, don't scale
+    if (source.resolution == destResolution) [[unlikely]] {
+        return ImageBuffer(source);
+    }
+
+    // Scale based upon the scale method
+    switch (method) {
+    case ScaleMethod::NearestNeighbor:
+        return NearestNeighbor(source, destResolution);
+    case ScaleMethod::Bilinear:
+        return Bilinear(source, destResolution);
+    case ScaleMethod::Area:
+        return Area(source, destResolution);
+    default:
+        break;
+    }
+
+    // The remaining methods index a tightly packed BGRA image, other 8-bit formats are scaled as one
+    if (source.format != PixelFormat::BGRA32) {
+
+        const bool convertible = BytesPerSample(source.format) == 1 &&
+            CanConvert(source.format, PixelFormat::BGRA32) && CanConvert(PixelFormat::BGRA32, source.format);
+
+        if (!convertible) { return ImageBuffer(); }
+
+        const ImageBuffer scaled = Scale(Convert(source, PixelFormat::BGRA32), destResolution);
+        return scaled.GetResolution() == destResolution ? Convert(scaled, source.format) : ImageBuffer();
+    }
+
+    const PixelData packed = source.IsPacked() ?
+        PixelData(source.data, source.data + source.PackedSize()) : ImageBuffer(source).Release();
+
+    switch (method) {
+    case ScaleMethod::Bicubic:
+        return ImageBuffer(Bicubic(packed, source.resolution, destResolution), destResolution);
+    case ScaleMethod::Lanczos:
+        return ImageBuffer(Lanczos(packed, source.resolution, destResolution), destResolution);
+    default:
+        return ImageBuffer();
     }
 }
 
-Thing SubtractPixel(const ConstPixel& subFrom, const ConstPixel& sub) {
-    Thing t;
-    for (size_t channel = 0; channel < BYTES_PER_PIXEL; ++channel) {
-        t[channel] = subFrom[channel] - sub[channel];
+bool Scaler::Scale(const ConstImageView& source, const ImageView& dest, StatsCollector* stats) {
+
+    // Scale in the source's format, then convert each row on its way into dest
+    if (source.format != dest.format) {
+
+        if (!CanConvert(source.format, dest.format)) { return false; }
+
+        if (_unconverted.GetResolution() != dest.resolution || _unconverted.Format() != source.format) {
+            _unconverted = ImageBuffer(dest.resolution, source.format);
+        }
+
+        if (!Scale(source, _unconverted.View())) { return false; }
+
+        const ConstImageView scaledView = _unconverted.View();
+
+        for (int y = 0; y < dest.resolution.height; ++y) {
+            ConvertRow(scaledView.Row(y), source.format, dest.Row(y), dest.format, dest.resolution.width);
+            if (stats != nullptr) { stats->AddRow(dest.Row(y), dest.resolution.width); }
+        }
+
+        return true;
     }
-    return t;
+
+    if (source.resolution == dest.resolution) [[unlikely]] {
+        for (int y = 0; y < dest.resolution.height; ++y) {
+            std::memcpy(dest.Row(y), source.Row(y), dest.RowSize());
+            if (stats != nullptr) { stats->AddRow(dest.Row(y), dest.resolution.width); }
+        }
+        return true;
+    }
+
+    if (RowScaler::Supports(method)) {
+        CachedRowScaler(source.resolution, dest.resolution, source.format).Scale(source, dest, stats);
+        return true;
+    }
+
+    // Whole image methods build their result first
+    const ImageBuffer scaled = Scale(source, dest.resolution);
+    const ConstImageView scaledView = scaled.View();
+
+    if (scaled.GetResolution() != dest.resolution) { return false; }
+
+    for (int y = 0; y < dest.resolution.height; ++y) {
+        std::memcpy(dest.Row(y), scaledView.Row(y), dest.RowSize());
+        if (stats != nullptr) { stats->AddRow(dest.Row(y), dest.resolution.width); }
+    }
+
+    return true;
 }
 
-Neighbors FindDerivatives(const bool xDir, const Resolution& res, const PixelData& data, const Neighbors& neighbors) {
+std::vector<ScreenArea> Scaler::Scale(const ConstImageView& source, const ImageView& dest,
+    const std::vector<ScreenArea>& dirtyAreas) {
 
-    static const Thing EmptyPixel = { 0, 0, 0, 0 };
+    std::vector<ScreenArea> destAreas;
 
-    Neighbors derivatives {};
+    if (source.format != dest.format || dirtyAreas.empty()) { return destAreas; }
 
-    int index = 0;
+    // Whole image methods can't be confined to an area
+    if (!RowScaler::Supports(method) || source.resolution == dest.resolution) {
 
-    std::for_each(neighbors.begin(), neighbors.end(), [&](const auto& pixelAndPos) {
+        Scale(source, dest);
+        destAreas.emplace_back(dest.resolution);
 
-        const auto& [pixelX, pixelY] = pixelAndPos.second;
-        const int X_MAX = res.width - 1;
-        const int Y_MAX = res.height - 1;
+        return destAreas;
+    }
 
-        const int MAX = xDir ? X_MAX : Y_MAX;
-        const int axis = xDir ? pixelX : pixelY;
+    RowScaler& rowScaler = CachedRowScaler(source.resolution, dest.resolution, source.format);
 
-        const int xChange = xDir ? 1 : 0;
-        const int yChange = xDir ? 0 : 1;
+    for (const ScreenArea& dirtyArea : dirtyAreas) {
 
-        const ConstPixel nextPixel = (axis >= MAX) ? EmptyPixel : GetPixel(data, CoordinateToIndex(res, { pixelX + xChange, pixelY + yChange }));
-        const ConstPixel prevPixel = (axis <= 0)   ? EmptyPixel : GetPixel(data, CoordinateToIndex(res, { pixelX - xChange, pixelY - yChange }));
+        const ScreenArea clamped {
+            std::max(dirtyArea.left, 0), std::min(dirtyArea.right, source.resolution.width),
+            std::max(dirtyArea.top, 0), std::min(dirtyArea.bottom, source.resolution.height)
+        };
 
-        derivatives[index++] = { SubtractPixel(nextPixel, prevPixel), pixelAndPos.second };
-    
-    });
-    
-    return derivatives;
+        if (clamped.left >= clamped.right || clamped.top >= clamped.bottom) { continue; }
+
+        // Grows by the filter's reach, every destination pixel touching the change is redone whole
+        const ScreenArea destArea = rowScaler.DestArea(clamped);
 
+        if (destArea.left >= destArea.right || destArea.top >= destArea.bottom) { continue; }
+
+        rowScaler.ScaleArea(source, dest, destArea);
+        destAreas.push_back(destArea);
+    }
+
+    return destAreas;
 }
 
-/* --------------------- */
+bool Scaler::ScaleToTensor(const ConstImageView& source, const Resolution& dest,
+    const TensorNormalization& normalization, std::span<float> tensor) {
 
-/* ----- Scaler ----- */
+    const size_t planeSize = static_cast<size_t>(dest.width) * dest.height;
 
-PixelData Scaler::Scale(const PixelData& sourceImage,
-    const Resolution& sourceResolution, const Resolution& destResolution) {
+    if (!RowScaler::Supports(method) || tensor.size() < planeSize * 3) { return false; }
 
-    // If the resolutions are the same, don't scale
-    if (sourceResolution == destResolution) [[unlikely]] {
-        return sourceImage;
+    // Where red, green and blue sit in a source pixel
+    const std::array<int, 4> order = ChannelOrder(source.format);
+    const std::array<int, 3> channels { order[2], order[1], order[0] };
+
+    const size_t bytesPerPixel = BytesPerPixel(source.format);
+
+    // Every byte value already normalized, for each plane
+    std::array<std::array<float, 256>, 3> normalized;
+    for (int plane = 0; plane < 3; ++plane) {
+        for (int value = 0; value < 256; ++value) {
+            normalized[plane][value] = (value / 255.0f - normalization.mean[plane]) / normalization.std[plane];
+        }
     }
 
-    // Scale based upon the scale method
-    switch (method) {
-    case ScaleMethod::NearestNeighbor:
-        return NearestNeighbor(sourceImage, sourceResolution, destResolution);
-    case ScaleMethod::Bilinear:
-        return Bilinear(sourceImage, sourceResolution, destResolution);
-    case ScaleMethod::Bicubic:
-        return Bicubic(sourceImage, sourceResolution, destResolution);
-    case ScaleMethod::Lanczos:
-        return Lanczos(sourceImage, sourceResolution, destResolution);
-    default:
-        return PixelData();
+    RowScaler& rowScaler = CachedRowScaler(source.resolution, dest, source.format);
+    rowScaler.Reset();
+
+    _scaledRows.resize(dest.width * bytesPerPixel);
+
+    for (int destY = 0; destY < dest.height; ++destY) {
+
+        // Same resolution only needs its pixels reordered
+        const Ubyte* row = reinterpret_cast<const Ubyte*>(source.Row(destY));
+
+        if (source.resolution != dest) {
+            rowScaler.ScaleRow(destY, source, _scaledRows.data());
+            row = _scaledRows.data();
+        }
+
+        for (int plane = 0; plane < 3; ++plane) {
+
+            float* planeRow = tensor.data() + plane * planeSize + static_cast<size_t>(destY) * dest.width;
+
+            // Too many deep colour values for a table
+            if (source.format == PixelFormat::BGRA64) {
+
+                const Ushort* samples = reinterpret_cast<const Ushort*>(row) + channels[plane];
+                const float scale = 1.0f / (65535.0f * normalization.std[plane]);
+                const float offset = normalization.mean[plane] / normalization.std[plane];
+
+                for (int destX = 0; destX < dest.width; ++destX) {
+                    planeRow[destX] = samples[destX * NUM_COLOR_CHANNELS] * scale - offset;
+                }
+                continue;
+            }
+
+            const std::array<float, 256>& toFloat = normalized[plane];
+            const Ubyte* sample = row + channels[plane];
+
+            for (int destX = 0; destX < dest.width; ++destX) {
+                planeRow[destX] = toFloat[sample[destX * bytesPerPixel]];
+            }
+        }
     }
 
+    return true;
 }
 
-PixelData Scaler::Scale(const PixelData& sourceImage,
-    const Resolution& sourceResolution, const ScaleRatio& scaleRatio) {
+bool Scaler::ScaleToYuv(const ConstImageView& source, YuvFrame& frame, const YuvConversion& conversion) {
 
-    return Scale(sourceImage, sourceResolution, 
-        Resolution { sourceResolution.width * scaleRatio.xRatio, sourceResolution.height * scaleRatio.yRatio });
+    const Resolution& dest = frame.GetResolution();
+
+    if (!RowScaler::Supports(method) || BytesPerSample(source.format) != 1 || ChannelCount(source.format) < 3) { return false; }
+
+    // Same resolution only needs converting
+    if (source.resolution == dest) { return ToYuv(source, frame, conversion); }
+
+    const YuvWeights weights = WeightsFor(conversion, source.format);
+
+    RowScaler& rowScaler = CachedRowScaler(source.resolution, dest, source.format);
+    rowScaler.Reset();
+
+    // Each pair of scaled rows shares a chroma row
+    const size_t rowSize = dest.width * BytesPerPixel(source.format);
+    _scaledRows.resize(2 * rowSize);
+
+    Ubyte* top = _scaledRows.data();
+    Ubyte* bottom = _scaledRows.data() + rowSize;
+
+    for (int destY = 0; destY < dest.height; destY += 2) {
+
+        const bool pair = destY + 1 < dest.height;
+        const size_t chromaOffset = (destY / 2) * frame.ChromaStride();
+
+        rowScaler.ScaleRow(destY, source, top);
+        if (pair) { rowScaler.ScaleRow(destY + 1, source, bottom); }
+
+        ToYuvRows(top, pair ? bottom : top, source.format, dest.width, weights,
+            reinterpret_cast<Ubyte*>(frame.Luma() + destY * dest.width),
+            pair ? reinterpret_cast<Ubyte*>(frame.Luma() + (destY + 1) * dest.width) : nullptr,
+            reinterpret_cast<Ubyte*>(frame.ChromaU() + chromaOffset), reinterpret_cast<Ubyte*>(frame.ChromaV() + chromaOffset),
+            frame.ChromaStep());
+    }
+
+    return true;
 }
 
-PixelData Scaler::Scale(const PixelData& sourceImage, const Resolution& sourceResolution, const Uint32 scalingFactor) {
-    return Scale(sourceImage, sourceResolution, ScaleRatio(scalingFactor, scalingFactor));
+ImageBuffer Scaler::Scale(const ConstImageView& source, const ScaleRatio& scaleRatio) const {
+    return Scale(source, Resolution { source.resolution.width * scaleRatio.xRatio, source.resolution.height * scaleRatio.yRatio });
 }
 
 // Get the ratio in the x and y directions between dest and source images
@@ -137,72 +1350,12 @@ Neighbors Scaler::GetNeighbors(const double x, const double y, const PixelData&
 }
 
 // Upscale using nearest neighbor technique
-PixelData Scaler::NearestNeighbor(const PixelData& source, const Resolution& src, const Resolution& dest) {
-
-    PixelData scaled(CalculateBMPFileSize(dest));
-    const auto [scaleX, scaleY] = GetScaleRatio(src, dest);
-
-    for (size_t absIndex = 0; absIndex < scaled.size(); absIndex += BYTES_PER_PIXEL) {
-
-        // Convert pixel index to x,y coordinates
-        const auto [destX, destY] = IndexToCoordinate(dest, ConvertIndex(absIndex, false));
-		Pixel scaledPixel = GetPixel(scaled, absIndex);
-
-        // Scale the coordinates
-        const Coordinate mappedCoord = { destX / scaleX, destY / scaleY };
-
-        // Convert the coordinates to index
-        const size_t indexToMap = CoordinateToIndex(src, mappedCoord);
-		ConstPixel sourcePixel = GetPixel(source, indexToMap, false);
-
-        // Set scaledPixel equal to corresponding sourcePixel 
-        AssignPixel(scaledPixel, sourcePixel);
-    }
-
-    return scaled;
+ImageBuffer Scaler::NearestNeighbor(const ConstImageView& source, const Resolution& dest) const {
+    return ScaleByRows(RowScaler(ScaleMethod::NearestNeighbor, source.resolution, dest, linearLight, source.format), source);
 }
 
-
-PixelData Scaler::Bilinear(const PixelData& source, const Resolution& src, const Resolution& dest) {
-
-    using enum Neighbor;
-
-    // Init new image and get scale between new and source
-    PixelData scaled(CalculateBMPFileSize(dest));
-    const auto [destX, destY] = GetScaleRatio(src, dest);
-
-    const int X_MAX_SRC = src.width - 1;
-    const int Y_MAX_SRC = src.height - 1;
-    
-    for (size_t absIndex = 0; absIndex < scaled.size(); absIndex += BYTES_PER_PIXEL) {
-
-        // Get the pixel's X and Y coordinates
-        const auto [scaledX, scaledY] = IndexToCoordinate(dest, ConvertIndex(absIndex, false));
-        const double x = scaledX / destX;
-        const double y = scaledY / destY;
-
-        // Create new pixel from neighboring 4 pixels
-        Pixel scaledPixel = GetPixel(scaled, absIndex);
-        Neighbors neighbors = GetNeighbors(x, y, source, src);
-
-        const int x_l = floor(x);
-        const int y_l = std::min((int)ceil(y), Y_MAX_SRC);
-
-        const double xl_weight = 1 - (x - x_l) / X_MAX_SRC;
-        const double xh_weight = 1 - xl_weight;
-
-        const double yl_weight = 1 - (y - y_l) / Y_MAX_SRC;
-        const double yh_weight = 1 - yl_weight;
-
-        for (size_t channel = 0; channel < NUM_COLOR_CHANNELS; ++channel) {
-            scaledPixel[channel] = 
-                (xl_weight * neighbors[(int)TopLeft].first[channel] + xh_weight * neighbors[(int)TopRight].first[channel]) * yl_weight +
-                (xl_weight * neighbors[(int)BottomLeft].first[channel] + xh_weight * neighbors[(int)BottomRight].first[channel]) * yh_weight;
-        }
-
-    }
-
-    return scaled;
+ImageBuffer Scaler::Bilinear(const ConstImageView& source, const Resolution& dest) const {
+    return ScaleByRows(RowScaler(ScaleMethod::Bilinear, source.resolution, dest, linearLight, source.format), source);
 }
 
 PixelData Scaler::Bicubic(const PixelData& source, const Resolution& src, const Resolution& dest) {
@@ -248,7 +1401,8 @@ PixelData Scaler::Bicubic(const PixelData& source, const Resolution& src, const
         Derivatives yDerivs = FindDerivatives(false, src, source, neighbors);
         Derivatives xyDerivs = FindDerivatives(false, src, source, xDerivs);
 
-        const MatrixFunc functionMatrix = [&](const int index) {
+        // A plain lambda, so the compiler can inline it for every channel
+        const auto functionMatrix = [&](const int index) {
             return MatrixD {
                 { (double)neighbors[(int)TopLeft].first[index],  (double)neighbors[(int)BottomLeft].first[index],  (double)yDerivs[(int)TopLeft].first[index],    (double)yDerivs[(int)BottomLeft].first[index]},
                 { (double)neighbors[(int)TopRight].first[index], (double)neighbors[(int)BottomRight].first[index], (double)yDerivs[(int)TopRight].first[index],   (double)yDerivs[(int)BottomRight].first[index]},
@@ -279,6 +1433,296 @@ PixelData Scaler::Bicubic(const PixelData& source, const Resolution& src, const
 }
 
 
+ImageBuffer Scaler::Area(const ConstImageView& source, const Resolution& dest) const {
+    return ScaleByRows(RowScaler(ScaleMethod::Area, source.resolution, dest, linearLight, source.format), source);
+}
+
+ImageBuffer Scaler::ScaleByRows(RowScaler&& rowScaler, const ConstImageView& source) const {
+
+    ImageBuffer scaled(rowScaler.DestResolution(), rowScaler.Format());
+    rowScaler.Scale(source, scaled.View());
+
+    return scaled;
+}
+
+RowScaler& Scaler::CachedRowScaler(const Resolution& src, const Resolution& dest, const PixelFormat format) {
+
+    if (!_rowScaler || !_rowScaler->Matches(method, src, dest, linearLight, format)) {
+        _rowScaler.emplace(method, src, dest, linearLight, format);
+    }
+
+    return *_rowScaler;
+}
+
+std::vector<ImageBuffer> Scaler::Scale(const ConstImageView& source, const std::vector<Resolution>& destResolutions) const {
+
+    std::vector<ImageBuffer> scaledImages;
+    scaledImages.reserve(destResolutions.size());
+
+    // Methods that need the whole image scale to each resolution separately
+    if (!RowScaler::Supports(method)) {
+        for (const Resolution& destResolution : destResolutions) {
+            scaledImages.push_back(Scale(source, destResolution));
+        }
+        return scaledImages;
+    }
+
+    // A destination resolution being filled in as the source is read band by band
+    struct Target {
+        RowScaler rowScaler;
+        ImageView scaled;
+        int nextRow = 0;
+    };
+
+    std::vector<Target> targets;
+
+    for (const Resolution& destResolution : destResolutions) {
+
+        if (destResolution == source.resolution) [[unlikely]] {
+            scaledImages.emplace_back(source);
+            continue;
+        }
+
+        scaledImages.emplace_back(destResolution, source.format);
+        targets.push_back({ RowScaler(method, source.resolution, destResolution, linearLight, source.format),
+            scaledImages.back().View() });
+    }
+
+    std::vector<const Ubyte*> rows;
+
+    // Read the source a band at a time and give every target all the rows it can make from it,
+    // the band is still in cache for each target after the first
+    for (int bandEnd = 0; bandEnd < source.resolution.height; ) {
+
+        bandEnd = std::min(bandEnd + SCALE_BAND_ROWS, source.resolution.height);
+
+        for (Target& target : targets) {
+
+            const Resolution& dest = target.rowScaler.DestResolution();
+
+            for (; target.nextRow < dest.height; ++target.nextRow) {
+
+                const int destY = target.nextRow;
+                if (target.rowScaler.LastSourceRow(destY) >= bandEnd) { break; }
+
+                rows.clear();
+                for (int row = target.rowScaler.FirstSourceRow(destY); row <= target.rowScaler.LastSourceRow(destY); ++row) {
+                    rows.push_back(reinterpret_cast<const Ubyte*>(source.Row(row)));
+                }
+
+                target.rowScaler.ScaleRow(destY, rows.data(), reinterpret_cast<Ubyte*>(target.scaled.Row(destY)));
+            }
+        }
+    }
+
+    return scaledImages;
+}
+
+/* ----- Pyramid ----- */
+
+ConstPixel Pyramid::LevelPixels(const size_t index) const {
+    const Level& level = levels[index];
+    return ConstPixel{ pixels }.subspan(level.offset, LevelView(index).PackedSize());
+}
+
+ConstImageView Pyramid::LevelView(const size_t index) const {
+    const Level& level = levels[index];
+    return { pixels.data() + level.offset, level.resolution, format };
+}
+
+// One level of a pyramid while it is being built
+struct PyramidStage {
+
+    // Rows kept for levels that weren't requested, enough for any halving footprint
+    static constexpr const int RING_ROWS = 3;
+
+    Resolution resolution { 0, 0 };
+    size_t rowSize = 0;
+    size_t stride = 0;
+
+    AreaTaps xTaps;
+    AreaTaps yTaps;
+    bool halves = false;   // Exactly half the level above, on both axes
+
+    // Either the level's place in the pyramid or a ring of rows in scratch space
+    size_t offset = 0;
+    bool kept = false;
+    bool ring = false;
+    Ubyte* rows = nullptr;
+
+    int nextRow = 0;       // Rows before this one have been produced
+
+    Ubyte* Row(const int y) const { return rows + (ring ? y % RING_ROWS : y) * stride; }
+};
+
+Pyramid Scaler::BuildPyramid(const PixelData& sourceImage, const Resolution& sourceResolution) {
+    return BuildPyramid(ConstImageView(sourceImage.data(), sourceResolution));
+}
+
+Pyramid Scaler::BuildPyramid(const PixelData& sourceImage, const Resolution& sourceResolution,
+    std::vector<int> levelNumbers) {
+    return BuildPyramid(ConstImageView(sourceImage.data(), sourceResolution), std::move(levelNumbers));
+}
+
+Pyramid Scaler::BuildPyramid(const ConstImageView& source) {
+
+    std::vector<int> levelNumbers;
+
+    for (Resolution res = source.resolution; res.width > 1 || res.height > 1; res = HalfResolution(res)) {
+        levelNumbers.push_back(levelNumbers.size() + 1);
+    }
+
+    return BuildPyramid(source, std::move(levelNumbers));
+}
+
+Pyramid Scaler::BuildPyramid(const ConstImageView& sourceImage, std::vector<int> levelNumbers) {
+
+    std::sort(levelNumbers.begin(), levelNumbers.end());
+    levelNumbers.erase(std::unique(levelNumbers.begin(), levelNumbers.end()), levelNumbers.end());
+    std::erase_if(levelNumbers, [](const int number) { return number < 0; });
+
+    Pyramid pyramid;
+    pyramid.format = sourceImage.format;
+
+    if (levelNumbers.empty() || BytesPerSample(sourceImage.format) > 1) { return pyramid; }
+
+    // Reduction kernels for the source's channel count
+    using HalveKernel = void (*)(const Ubyte* const*, Ushort*, const int, const int, Ubyte*);
+    using ReduceKernel = void (*)(const Ubyte* const*, const Uint32*, const int, const AreaTaps&,
+        const Uint64, Uint32*, const int, const int, Ubyte*);
+
+    HalveKernel halve = AreaIntegerRow<2, 4>;
+    ReduceKernel reduce = AreaRow<4, Ubyte>;
+
+    switch (ChannelCount(sourceImage.format)) {
+    case 1:
+        halve = AreaIntegerRow<2, 1>;
+        reduce = AreaRow<1, Ubyte>;
+        break;
+    case 3:
+        halve = AreaIntegerRow<2, 3>;
+        reduce = AreaRow<3, Ubyte>;
+        break;
+    default:
+        break;
+    }
+
+    // Lay out every requested level in a single allocation
+    std::vector<PyramidStage> stages(levelNumbers.back() + 1);
+    size_t pyramidSize = 0;
+    size_t ringSize = 0;
+
+    for (int number = 0; number < (int)stages.size(); ++number) {
+
+        PyramidStage& stage = stages[number];
+        stage.resolution = number == 0 ? sourceImage.resolution : HalfResolution(stages[number - 1].resolution);
+        stage.rowSize = stage.resolution.width * BytesPerPixel(sourceImage.format);
+        stage.stride = stage.rowSize;
+
+        if (std::binary_search(levelNumbers.begin(), levelNumbers.end(), number)) {
+            pyramid.levels.push_back({ number, stage.resolution, pyramidSize });
+            stage.offset = pyramidSize;
+            stage.kept = true;
+            pyramidSize += stage.rowSize * stage.resolution.height;
+        }
+        else if (number > 0) {
+            stage.offset = ringSize;
+            stage.ring = true;
+            ringSize += stage.rowSize * PyramidStage::RING_ROWS;
+        }
+
+        if (number > 0) {
+            const Resolution& above = stages[number - 1].resolution;
+
+            stage.halves = above.width == stage.resolution.width * 2 && above.height == stage.resolution.height * 2;
+
+            if (!stage.halves) {
+                stage.xTaps = AreaFootprints(above.width, stage.resolution.width);
+                stage.yTaps = AreaFootprints(above.height, stage.resolution.height);
+            }
+        }
+    }
+
+    pyramid.pixels = PixelData(pyramidSize);
+    std::vector<Ubyte> ringRows(ringSize);
+
+    for (PyramidStage& stage : stages) {
+        if (stage.kept) {
+            stage.rows = reinterpret_cast<Ubyte*>(pyramid.pixels.data()) + stage.offset;
+        }
+        else if (stage.ring) {
+            stage.rows = ringRows.data() + stage.offset;
+        }
+    }
+
+    // Level 0 reads straight from the source, copied only if it was requested
+    PyramidStage& source = stages.front();
+
+    if (source.kept) {
+        for (int y = 0; y < source.resolution.height; ++y) {
+            std::memcpy(source.Row(y), sourceImage.Row(y), source.rowSize);
+        }
+    }
+
+    source.rows = reinterpret_cast<Ubyte*>(const_cast<MyByte*>(sourceImage.data));
+    source.stride = sourceImage.stride;
+
+    // Scratch space shared by every level, the source has the widest rows
+    std::vector<Uint32> columnSums(source.rowSize);
+    std::vector<Ushort> rowSums(source.rowSize);
+    std::array<const Ubyte*, PyramidStage::RING_ROWS> rows {};
+
+    // Feed the source in a row at a time and push each row as far down as it goes,
+    // so a row is reduced into the next level while it is still in cache
+    for (source.nextRow = 1; source.nextRow <= source.resolution.height; ++source.nextRow) {
+
+        for (size_t number = 1; number < stages.size(); ++number) {
+
+            PyramidStage& stage = stages[number];
+            const PyramidStage& above = stages[number - 1];
+
+            bool produced = false;
+
+            while (stage.nextRow < stage.resolution.height) {
+
+                const int y = stage.nextRow;
+
+                if (stage.halves) {
+                    if (y * 2 + 1 >= above.nextRow) { break; }
+
+                    rows[0] = above.Row(y * 2);
+                    rows[1] = above.Row(y * 2 + 1);
+
+                    halve(rows.data(), rowSums.data(), 0, stage.resolution.width, stage.Row(y));
+                }
+                else {
+                    const AreaFootprint& footprint = stage.yTaps.footprints[y];
+                    if (footprint.first + footprint.count > above.nextRow) { break; }
+
+                    for (int row = 0; row < footprint.count; ++row) {
+                        rows[row] = above.Row(footprint.first + row);
+                    }
+
+                    const Uint64 area = static_cast<Uint64>(above.resolution.width) * above.resolution.height;
+
+                    reduce(rows.data(), stage.yTaps.weights.data() + footprint.weights, footprint.count,
+                        stage.xTaps, area, columnSums.data(), 0, stage.resolution.width, stage.Row(y));
+                }
+
+                ++stage.nextRow;
+                produced = true;
+            }
+
+            // Nothing new at this level means nothing new below it either
+            if (!produced) { break; }
+        }
+    }
+
+    return pyramid;
+}
+
+/* ------------------- */
+
 // TODO: Implement Lanczos scaling
 PixelData Scaler::Lanczos(const PixelData& source, const Resolution& src, const Resolution& dest) {
     return PixelData();
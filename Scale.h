@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Eigen/Dense"
-#include "TypesAndDefs.h"
+#include "Convert.h"
 
 // X and Y positions of a pixel
 using Coordinate = std::pair<int, int>;
@@ -51,15 +51,107 @@ static Pixel GetPixel(PixelData& data, const size_t index, const bool isAbsolute
 // Returns a const pixel at index of data
 static ConstPixel GetPixel(const PixelData& data, const size_t index, const bool isAbsoluteIndex = true);
 
-// Assign 1 pixel's values to another
-static void AssignPixel(Pixel& assignee, const ConstPixel& other);
-
 static Thing SubtractPixel(const ConstPixel& subFrom, const ConstPixel& sub);
 
 static Neighbors FindDerivatives(const bool xDir, const Resolution& res, const PixelData& data, const Neighbors& neighbors);
 
 /*-----------------------------------*/
 
+/*------Fixed Point Bilinear---------*/
+
+// Fractional bits of a bilinear weight, 7 keeps the product of an x and y weight in a signed 16-bit lane
+constexpr const int BILINEAR_WEIGHT_BITS = 7;
+constexpr const int BILINEAR_ONE = 1 << BILINEAR_WEIGHT_BITS;
+
+// Source pixels on either side of a destination pixel and how far it is towards the high one
+struct BilinearTap {
+    int low = 0;
+    int high = 0;
+    int weight = 0;
+};
+
+// Map every destination column ( or row ) to its source taps, sampling at pixel centres
+static std::vector<BilinearTap> BilinearTaps(const int srcLength, const int destLength);
+
+// Read a 4 byte pixel as a single integer
+static Uint32 LoadPixel(const Ubyte* pixel);
+
+// Blend 4 pixels using fixed point weights, all channels at once, rounding to nearest
+static Uint32 BlendBilinear(const Uint32 topLeft, const Uint32 topRight,
+    const Uint32 bottomLeft, const Uint32 bottomRight, const int xWeight, const int yWeight);
+
+// Same as above for pixels of 16-bit samples, linear light or deep colour
+static Uint64 LoadPixel(const Ushort* pixel);
+static Uint64 BlendBilinear(const Uint64 topLeft, const Uint64 topRight,
+    const Uint64 bottomLeft, const Uint64 bottomRight, const int xWeight, const int yWeight);
+
+// Blend one destination row from the 2 source rows around it, pixels have Channels samples
+template <int Channels, typename Sample>
+static void BilinearRow(const Sample* topRow, const Sample* bottomRow, const std::vector<BilinearTap>& xTaps,
+    const int yWeight, const int destBegin, const int destEnd, Sample* scaledRow);
+
+/*-----------------------------------*/
+
+/*----------Linear Light-------------*/
+
+// Precision of linear light samples, enough that every sRGB byte survives a round trip
+constexpr const int LINEAR_BITS = 12;
+constexpr const int LINEAR_MAX = (1 << LINEAR_BITS) - 1;
+
+// Lookup tables between sRGB bytes and linear light
+static const std::array<Ushort, 256>& SrgbToLinear();
+static const std::array<Ubyte, LINEAR_MAX + 1>& LinearToSrgb();
+
+// Convert a row of pixels, alpha ( sample alphaSample of every 4, none when it is -1 ) is only rescaled
+static void ToLinearRow(const Ubyte* row, Ushort* linearRow, const size_t length, const int alphaSample = 3);
+static void ToSrgbRow(const Ushort* linearRow, Ubyte* row, const size_t length, const int alphaSample = 3);
+
+/*-----------------------------------*/
+
+/*--------Integer Zoom---------------*/
+
+// Write every source pixel under destination columns destBegin to destEnd factor times in a row
+template <int Channels>
+static void ReplicateRow(const Ubyte* sourceRow, const int factor, const int destBegin, const int destEnd, Ubyte* scaledRow);
+
+/*-----------------------------------*/
+
+/*---------Area Averaging------------*/
+
+// Source pixels under one destination pixel, their coverage is stored in AreaTaps::weights
+struct AreaFootprint {
+    int first = 0;
+    int count = 0;
+    size_t weights = 0;
+};
+
+// How much of each source pixel every destination column ( or row ) covers,
+// weights are in 1 / destLength of a source pixel so they sum to srcLength
+struct AreaTaps {
+    std::vector<AreaFootprint> footprints;
+    std::vector<Uint32> weights;
+};
+
+static AreaTaps AreaFootprints(const int srcLength, const int destLength);
+
+// Add a row of bytes into 16-bit running sums
+static void AccumulateRow(Ushort* sums, const Ubyte* row, const size_t length);
+
+// Add a row of deep colour samples into 32-bit running sums
+static void AccumulateRow(Uint32* sums, const Ushort* row, const size_t length);
+
+// Produce columns destBegin to destEnd of a destination row from the weighted source rows under it
+template <int Channels, typename Sample>
+static void AreaRow(const Sample* const* rows, const Uint32* rowWeights, const int rowCount, const AreaTaps& xTaps,
+    const Uint64 area, Uint32* columnSums, const int destBegin, const int destEnd, Sample* scaledRow);
+
+// Produce columns destBegin to destEnd of a destination row from Factor source rows,
+// Sum must be wide enough for Factor * Factor samples
+template <int Factor, int Channels, typename Sample, typename Sum>
+static void AreaIntegerRow(const Sample* const* rows, Sum* rowSums, const int destBegin, const int destEnd, Sample* scaledRow);
+
+/*-----------------------------------*/
+
 
 // Scale between two images in x and y directions ( new / old )
 struct ScaleRatio {
@@ -71,36 +163,244 @@ struct ScaleRatio {
     ScaleRatio(const Resolution& ratio) : xRatio(ratio.width), yRatio(ratio.height) {}
 };
 
+// Per channel normalization of model input in RGB order, each value becomes ( value / 255 - mean ) / std
+struct TensorNormalization {
+    std::array<float, 3> mean { 0, 0, 0 };
+    std::array<float, 3> std { 1, 1, 1 };
+};
 
-class Scaler {
+// Successive halvings of an image, every level stored back to back in one allocation
+struct Pyramid {
+
+    struct Level {
+        int number = 0;                   // How many times the source was halved
+        Resolution resolution { 0, 0 };
+        size_t offset = 0;                // Where the level starts in pixels
+    };
+
+    PixelData pixels;
+    std::vector<Level> levels;
+    PixelFormat format = PixelFormat::BGRA32;
+
+    // The pixels of the level at index ( not level number )
+    ConstPixel LevelPixels(const size_t index) const;
+    ConstImageView LevelView(const size_t index) const;
+};
+
+// Size of the next level down a pyramid, each side halves but never drops below 1
+constexpr Resolution HalfResolution(const Resolution& res) {
+    return { std::max(res.width / 2, 1), std::max(res.height / 2, 1) };
+}
+
+// Source rows read at a time when scaling to several resolutions at once
+constexpr const int SCALE_BAND_ROWS = 16;
+
+// Supported scaling methods
+enum class ScaleMethod {
+    NearestNeighbor,
+    Bilinear,
+    Bicubic,  // 8-bit formats only, there is no deep colour kernel
+    Area,
+    Lanczos   // Not implemented
+};
+
+// Scales an image one destination row at a time, for callers that hold the source a band of rows at a time
+class RowScaler {
+
+private:
+
+    ScaleMethod _method;
+    Resolution _src;
+    Resolution _dest;
+    PixelFormat _format;
+    int _channels;
+    int _sampleSize;   // Bytes a channel, 2 for deep colour
+
+    // Source column and row of each destination pixel
+    std::vector<int> _nearestColumns;
+    std::vector<int> _nearestRows;
+
+    // Whole numbers nearest neighbor enlarges each axis by, 0 if either isn't one
+    int _zoomX = 0;
+    int _zoomY = 0;
+
+    std::vector<BilinearTap> _xBilinear;
+    std::vector<BilinearTap> _yBilinear;
+
+    // Whole number the area scaler shrinks by, 0 if it isn't one
+    int _areaFactor = 0;
+    AreaTaps _xArea;
+    AreaTaps _yArea;
+    Uint64 _area = 0;
+
+    // Source rows of the destination row being scaled
+    std::vector<const Ubyte*> _sourceRows;
+
+    // Scratch space for the area scaler
+    std::vector<Uint32> _columnSums;
+    std::vector<Ushort> _rowSums;
+
+    // Source rows converted to linear light, row n is kept in slot n % _linearRowCount
+    bool _linearLight = false;
+    int _linearRowCount = 0;
+    std::vector<Ushort> _linearRows;
+    std::vector<int> _linearRowTags;
+
+    // First and last source column converted in each slot, spans only convert the columns they read
+    std::vector<std::pair<int, int>> _linearRowColumns;
+
+    // Rows of 16-bit samples handed to the wide kernel, linear light or deep colour
+    std::vector<const Ushort*> _wideSourceRows;
+    std::vector<Ushort> _linearDestRow;
+
+    // Scale part of a row of bytes or linear samples, compiled once for every method and channel count
+    template <ScaleMethod Method, int Channels, typename Sample>
+    void ScaleSamples(const int destY, const Sample* const* sourceRows, Sample* destRow,
+        const int destBegin, const int destEnd);
+
+    template <typename Sample>
+    using Kernel = void (RowScaler::*)(const int, const Sample* const*, Sample*, const int, const int);
+
+    // Specialisations of ScaleSamples for this method and format, picked once when built
+    Kernel<Ubyte> _byteKernel = nullptr;
+    Kernel<Ushort> _wideKernel = nullptr;
+
+    template <int Channels>
+    void SelectKernels();
+
+    // Index of the first sample ( or byte ) of a pixel in a row
+    size_t SampleIndex(const int pixel) const;
+    size_t ByteIndex(const int pixel) const;
 
 public:
 
-    // Supported scaling methods
-    enum class ScaleMethod {
-        NearestNeighbor,
-        Bilinear,
-        Bicubic,
-        Lanczos   // Not implemented
-    };
+    RowScaler(const ScaleMethod method, const Resolution& src, const Resolution& dest,
+        const bool linearLight = false, const PixelFormat format = PixelFormat::BGRA32);
+
+    // Whether method can be scaled a row at a time
+    static bool Supports(const ScaleMethod method);
+
+    // Whether this was built with the same settings
+    bool Matches(const ScaleMethod method, const Resolution& src, const Resolution& dest,
+        const bool linearLight, const PixelFormat format) const;
+
+    // Forget rows kept from the previous image
+    void Reset();
+
+    // Scale a whole image, dest must be DestResolution(). Each finished row is added to stats while it is still in cache
+    void Scale(const ConstImageView& source, const ImageView& dest, StatsCollector* stats = nullptr);
+
+    // Most source rows any destination row reads
+    int MaxSourceRows() const;
+
+    // Range of source rows destination row destY reads
+    int FirstSourceRow(const int destY) const;
+    int LastSourceRow(const int destY) const;
 
-    // Default Scaling Method
-    static inline ScaleMethod method = ScaleMethod::NearestNeighbor; 
+    // Scale destination row destY, sourceRows holds rows FirstSourceRow(destY) to LastSourceRow(destY)
+    void ScaleRow(const int destY, const Ubyte* const* sourceRows, Ubyte* destRow);
 
-    static PixelData Scale(const PixelData& sourceImage,
-        const Resolution& sourceResolution, const Resolution& destResolution);
+    // Scale destination row destY reading its rows straight from a whole source image
+    void ScaleRow(const int destY, const ConstImageView& source, Ubyte* destRow);
 
-    static PixelData Scale(const PixelData& sourceImage,
-        const Resolution& sourceResolution, const ScaleRatio& scaleRatio);
+    // Only scale columns destBegin to destEnd of the row, destRow still points at the start of the row
+    void ScaleSpan(const int destY, const Ubyte* const* sourceRows, Ubyte* destRow,
+        const int destBegin, const int destEnd);
 
-    static PixelData Scale(const PixelData& sourceImage,
-        const Resolution& sourceResolution, const Uint32 scalingFactor);
+    // First and last source column that destination columns destBegin to destEnd read
+    std::pair<int, int> SourceColumns(const int destBegin, const int destEnd) const;
+
+    // Every destination pixel that reads any source pixel in sourceArea, empty if there are none
+    ScreenArea DestArea(const ScreenArea& sourceArea) const;
+
+    // Only rescale the pixels of dest in destArea
+    void ScaleArea(const ConstImageView& source, const ImageView& dest, const ScreenArea& destArea);
+
+    const Resolution& SourceResolution() const;
+    const Resolution& DestResolution() const;
+    PixelFormat Format() const;
+};
+
+// Scales images with its own settings and scratch space, give each thread its own scaler
+class Scaler {
 
 private:
 
-    // Class shouldn't be instantiated, it is static
-    Scaler() = delete;
-    ~Scaler() = delete;
+    // Row scaler for the last sizes scaled into a caller's view
+    std::optional<RowScaler> _rowScaler;
+
+    // Scaled rows on their way into a tensor or YUV frame
+    std::vector<Ubyte> _scaledRows;
+
+    // Scaled in the source's format, for a caller's view in another format
+    ImageBuffer _unconverted;
+
+public:
+
+    using ScaleMethod = ::ScaleMethod;
+
+    ScaleMethod method = ScaleMethod::Bilinear;
+
+    // Blend in linear light instead of on gamma encoded values, keeps thin lines and text from darkening
+    bool linearLight = false;
+
+    Scaler(const ScaleMethod method = ScaleMethod::Bilinear, const bool linearLight = false);
+
+    PixelData Scale(const PixelData& sourceImage,
+        const Resolution& sourceResolution, const Resolution& destResolution) const;
+
+    PixelData Scale(const PixelData& sourceImage,
+        const Resolution& sourceResolution, const ScaleRatio& scaleRatio) const;
+
+    PixelData Scale(const PixelData& sourceImage,
+        const Resolution& sourceResolution, const Uint32 scalingFactor) const;
+
+    // Scale to every resolution in one pass over the source, in the same order as destResolutions
+    std::vector<PixelData> Scale(const PixelData& sourceImage,
+        const Resolution& sourceResolution, const std::vector<Resolution>& destResolutions) const;
+
+    // Scale any view, rows can be padded or cropped out of a larger image. The result keeps the view's format.
+    // Bicubic and Lanczos scale BGRA32, other 8-bit formats go through it and back. Deep colour ( BGRA64 )
+    // only scales with NearestNeighbor, Bilinear and Area, the others leave the result empty
+    ImageBuffer Scale(const ConstImageView& source, const Resolution& destResolution) const;
+
+    ImageBuffer Scale(const ConstImageView& source, const ScaleRatio& scaleRatio) const;
+
+    std::vector<ImageBuffer> Scale(const ConstImageView& source, const std::vector<Resolution>& destResolutions) const;
+
+    // Scale into memory the caller owns, scaling the same sizes again allocates nothing
+    // for every method but Bicubic and Lanczos. A dest in another format is scaled in the source's
+    // and converted, false when the formats can't be converted or the method can't scale source,
+    // which Bicubic and Lanczos can't for deep colour.
+    // stats, when given, collects the scaled rows as they are written
+    bool Scale(const ConstImageView& source, const ImageView& dest, StatsCollector* stats = nullptr);
+
+    // Scale straight into a planar RGB float tensor ( CHW ) for model input, crop first with ConstImageView::Crop.
+    // Each source row is read once and only one scaled row is ever held as bytes.
+    // tensor needs room for 3 * dest.width * dest.height floats, false if it doesn't or method can't scale by rows
+    bool ScaleToTensor(const ConstImageView& source, const Resolution& dest,
+        const TensorNormalization& normalization, std::span<float> tensor);
+
+    // Scale straight into a 4:2:0 frame for a video encoder, the frame's resolution is the destination.
+    // Only two scaled rows are ever held as colour, false if source isn't 8-bit colour or method can't scale by rows
+    bool ScaleToYuv(const ConstImageView& source, YuvFrame& frame, const YuvConversion& conversion = {});
+
+    // Rescale only what changed since dest was scaled from the previous frame, dirtyAreas are in source pixels.
+    // The result is identical to a full rescale, returns the areas of dest that were rewritten.
+    // Both views must have the same format, nothing is rewritten when they don't
+    std::vector<ScreenArea> Scale(const ConstImageView& source, const ImageView& dest,
+        const std::vector<ScreenArea>& dirtyAreas);
+
+    // Area average every level down to 1x1, each level is reduced from the one above it. 8-bit formats only
+    static Pyramid BuildPyramid(const PixelData& sourceImage, const Resolution& sourceResolution);
+    static Pyramid BuildPyramid(const ConstImageView& source);
+
+    // Only keep the requested level numbers, levels in between are streamed through a few rows
+    static Pyramid BuildPyramid(const PixelData& sourceImage, const Resolution& sourceResolution,
+        std::vector<int> levelNumbers);
+    static Pyramid BuildPyramid(const ConstImageView& source, std::vector<int> levelNumbers);
+
+private:
 
     // Get the ratio in the x and y directions between dest and source images
     static ScaleRatio GetScaleRatio(const Resolution& source, const Resolution& dest);
@@ -111,15 +411,69 @@ private:
     /* ----- Scaling Functions ----- */
 
     // Upscale using nearest neighbor ( blockiest results )
-    static PixelData NearestNeighbor(const PixelData& source, const Resolution& src, const Resolution& dest);
+    ImageBuffer NearestNeighbor(const ConstImageView& source, const Resolution& dest) const;
 
-    // Upscale by linearly interpolating pixel values ( blurry )
-    static PixelData Bilinear(const PixelData& source, const Resolution& src, const Resolution& dest);
+    // Scale by linearly interpolating pixel values in fixed point ( blurry )
+    ImageBuffer Bilinear(const ConstImageView& source, const Resolution& dest) const;
 
     static PixelData Bicubic(const PixelData& source, const Resolution& src, const Resolution& dest);
+
+    // Average every source pixel under each destination pixel ( best for large reductions )
+    ImageBuffer Area(const ConstImageView& source, const Resolution& dest) const;
+
+    // Run a row scaler over a whole source image
+    ImageBuffer ScaleByRows(RowScaler&& rowScaler, const ConstImageView& source) const;
+
+    // The row scaler for these sizes and the current settings, rebuilt only when they change
+    RowScaler& CachedRowScaler(const Resolution& src, const Resolution& dest, const PixelFormat format);
     
     // TODO: Implement Lanczos scaling
     static PixelData Lanczos(const PixelData& source, const Resolution& src, const Resolution& dest);
 
 
-};
\ No newline at end of file
+};
+
+// Scales a source that arrives one row at a time, in order. Only the source rows the filter
+// still needs are kept and each destination row goes to onRow as soon as it is complete.
+// Only methods RowScaler::Supports can stream
+class StreamingScaler {
+
+public:
+
+    // Receives destination rows in order, row is only valid during the call
+    using RowCallback = std::function<void(const int destY, ConstPixel row)>;
+
+private:
+
+    RowScaler _rowScaler;
+    RowCallback _onRow;
+
+    // The last source rows pushed, row n is kept in slot n % _ringRows
+    int _ringRows = 0;
+    size_t _rowSize = 0;
+    std::vector<Ubyte> _ring;
+
+    std::vector<const Ubyte*> _sourceRows;
+    std::vector<Ubyte> _destRow;
+
+    int _nextSourceRow = 0;
+    int _nextDestRow = 0;
+
+public:
+
+    StreamingScaler(const ScaleMethod method, const Resolution& src, const Resolution& dest,
+        RowCallback onRow, const bool linearLight = false, const PixelFormat format = PixelFormat::BGRA32);
+
+    // Add the next source row, it must be a whole row of the source in Format(). Shorter rows are ignored
+    void PushRow(ConstPixel row);
+
+    // Whether every destination row has been handed out
+    bool IsComplete() const;
+
+    // Start over with a new source image
+    void Reset();
+
+    const Resolution& SourceResolution() const;
+    const Resolution& DestResolution() const;
+    PixelFormat Format() const;
+};
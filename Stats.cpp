@@ -0,0 +1,264 @@
+#include "Stats.h"
+
+/* ----- Stats Collector ----- */
+
+StatsCollector::StatsCollector(const PixelFormat format, const bool histograms) : _histograms(histograms) {
+    Reset(format);
+}
+
+void StatsCollector::Reset(const PixelFormat format) {
+    _format = format;
+    _channels = static_cast<int>(ChannelCount(format));
+
+    if (_histograms) { _counts.assign(HISTOGRAM_WAYS * _channels * 256, 0); }
+
+    Reset();
+}
+
+void StatsCollector::Reset() {
+    _min.fill(255);
+    _max.fill(0);
+    _sums.fill(0);
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _pixels = 0;
+}
+
+// Smallest, largest and total of each sample of a row, kept in min, max and sums
+template <int Channels>
+void SummarizeRow(const Ubyte* row, const int width, Ubyte* min, Ubyte* max, Uint64* sums) {
+
+    const size_t length = static_cast<size_t>(width) * Channels;
+    size_t index = 0;
+
+#if defined(QUICKSHOT_SSE2)
+
+    // 3 channel pixels line up with the lanes again every 3 vectors, the others every vector.
+    // Vectors holding the same channels fold into the same running values, 4 of them a pass
+    constexpr int vectors = Channels == 3 ? 3 : 1;
+    constexpr int folds = 4 / vectors;
+    constexpr size_t step = 16 * vectors * folds;
+
+    if (length >= step) {
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lowBytes = _mm_set1_epi16(0xFF);
+
+        // Even bytes of each vector are summed in lowSums and odd ones in highSums, masking and
+        // shifting them into 16-bit lanes keeps clear of the one port that does byte shuffles
+        __m128i mins[vectors], maxes[vectors], lowSums[vectors], highSums[vectors];
+        for (int vector = 0; vector < vectors; ++vector) {
+            mins[vector] = _mm_set1_epi8(-1);
+            maxes[vector] = lowSums[vector] = highSums[vector] = zero;
+        }
+
+        // Totals of every byte of the vectors
+        Uint64 laneSums[vectors][16] {};
+
+        while (index + step <= length) {
+
+            // Bytes are summed in 16 bits, folds a pass, until those could overflow
+            for (int pass = 0; pass < 256 / folds && index + step <= length; ++pass, index += step) {
+                for (int vector = 0; vector < vectors * folds; ++vector) {
+
+                    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + index + 16 * vector));
+
+                    mins[vector % vectors] = _mm_min_epu8(mins[vector % vectors], bytes);
+                    maxes[vector % vectors] = _mm_max_epu8(maxes[vector % vectors], bytes);
+
+                    // Every byte of gray is the same channel, psadbw totals them in 64 bits
+                    if constexpr (Channels == 1) {
+                        lowSums[0] = _mm_add_epi64(lowSums[0], _mm_sad_epu8(bytes, zero));
+                    }
+                    else {
+                        lowSums[vector % vectors] = _mm_add_epi16(lowSums[vector % vectors], _mm_and_si128(bytes, lowBytes));
+                        highSums[vector % vectors] = _mm_add_epi16(highSums[vector % vectors], _mm_srli_epi16(bytes, 8));
+                    }
+                }
+            }
+
+            if constexpr (Channels == 1) {
+                alignas(16) Uint64 halves[2];
+                _mm_store_si128(reinterpret_cast<__m128i*>(halves), lowSums[0]);
+                laneSums[0][0] += halves[0] + halves[1];
+                lowSums[0] = zero;
+                continue;
+            }
+
+            for (int vector = 0; vector < vectors; ++vector) {
+
+                alignas(16) Ushort low[8], high[8];
+                _mm_store_si128(reinterpret_cast<__m128i*>(low), lowSums[vector]);
+                _mm_store_si128(reinterpret_cast<__m128i*>(high), highSums[vector]);
+
+                for (int lane = 0; lane < 8; ++lane) {
+                    laneSums[vector][2 * lane] += low[lane];
+                    laneSums[vector][2 * lane + 1] += high[lane];
+                }
+
+                lowSums[vector] = highSums[vector] = zero;
+            }
+        }
+
+        // Halve the smallest and largest bytes down to the first pixel, 3 channel vectors don't split evenly
+        if constexpr (Channels != 3) {
+            mins[0] = _mm_min_epu8(mins[0], _mm_srli_si128(mins[0], 8));
+            maxes[0] = _mm_max_epu8(maxes[0], _mm_srli_si128(maxes[0], 8));
+            mins[0] = _mm_min_epu8(mins[0], _mm_srli_si128(mins[0], 4));
+            maxes[0] = _mm_max_epu8(maxes[0], _mm_srli_si128(maxes[0], 4));
+        }
+
+        if constexpr (Channels == 1) {
+            mins[0] = _mm_min_epu8(mins[0], _mm_srli_si128(mins[0], 2));
+            maxes[0] = _mm_max_epu8(maxes[0], _mm_srli_si128(maxes[0], 2));
+            mins[0] = _mm_min_epu8(mins[0], _mm_srli_si128(mins[0], 1));
+            maxes[0] = _mm_max_epu8(maxes[0], _mm_srli_si128(maxes[0], 1));
+        }
+
+        // Fold each byte of the vectors into the channel it holds
+        for (int vector = 0; vector < vectors; ++vector) {
+
+            alignas(16) Ubyte lowest[16], highest[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lowest), mins[vector]);
+            _mm_store_si128(reinterpret_cast<__m128i*>(highest), maxes[vector]);
+
+            for (int lane = 0; lane < 16; ++lane) {
+
+                const int channel = (vector * 16 + lane) % Channels;
+
+                if (Channels == 3 || lane < Channels) {
+                    min[channel] = std::min(min[channel], lowest[lane]);
+                    max[channel] = std::max(max[channel], highest[lane]);
+                }
+
+                sums[channel] += laneSums[vector][lane];
+            }
+        }
+    }
+
+#endif
+
+    for (; index < length; ++index) {
+        const int channel = index % Channels;
+        min[channel] = std::min(min[channel], row[index]);
+        max[channel] = std::max(max[channel], row[index]);
+        sums[channel] += row[index];
+    }
+}
+
+// Count every sample of a row into the histograms of its channel, pixel x uses way x % HISTOGRAM_WAYS
+template <int Channels>
+void CountRow(const Ubyte* row, const int width, Uint32* counts) {
+
+    constexpr int waySize = Channels * 256;
+
+    int x = 0;
+
+    for (; x + HISTOGRAM_WAYS <= width; x += HISTOGRAM_WAYS) {
+        for (int way = 0; way < HISTOGRAM_WAYS; ++way) {
+
+            const Ubyte* pixel = row + (x + way) * Channels;
+            Uint32* wayCounts = counts + way * waySize;
+
+            for (int channel = 0; channel < Channels; ++channel) {
+                ++wayCounts[channel * 256 + pixel[channel]];
+            }
+        }
+    }
+
+    for (; x < width; ++x) {
+        for (int channel = 0; channel < Channels; ++channel) {
+            ++counts[channel * 256 + row[x * Channels + channel]];
+        }
+    }
+}
+
+template <int Channels>
+void AddSamples(const Ubyte* row, const int width, const bool histograms, Ubyte* min, Ubyte* max, Uint64* sums, Uint32* counts) {
+    SummarizeRow<Channels>(row, width, min, max, sums);
+    if (histograms) { CountRow<Channels>(row, width, counts); }
+}
+
+void StatsCollector::AddRow(const MyByte* row, const int width) {
+
+    if (BytesPerSample(_format) != 1) { return; }
+
+    const Ubyte* samples = reinterpret_cast<const Ubyte*>(row);
+
+    switch (_channels) {
+    case 1:
+        AddSamples<1>(samples, width, _histograms, _min.data(), _max.data(), _sums.data(), _counts.data());
+        break;
+    case 3:
+        AddSamples<3>(samples, width, _histograms, _min.data(), _max.data(), _sums.data(), _counts.data());
+        break;
+    default:
+        AddSamples<4>(samples, width, _histograms, _min.data(), _max.data(), _sums.data(), _counts.data());
+        break;
+    }
+
+    _pixels += width;
+}
+
+void StatsCollector::Add(const ConstImageView& image) {
+    for (int y = 0; y < image.resolution.height; ++y) {
+        AddRow(image.Row(y), image.resolution.width);
+    }
+}
+
+void StatsCollector::Merge(const StatsCollector& other) {
+
+    if (other._format != _format || other._histograms != _histograms) { return; }
+
+    for (int channel = 0; channel < _channels; ++channel) {
+        _min[channel] = std::min(_min[channel], other._min[channel]);
+        _max[channel] = std::max(_max[channel], other._max[channel]);
+        _sums[channel] += other._sums[channel];
+    }
+
+    std::transform(_counts.begin(), _counts.end(), other._counts.begin(), _counts.begin(), std::plus<Uint32>());
+    _pixels += other._pixels;
+}
+
+PixelFormat StatsCollector::Format() const { return _format; }
+
+bool StatsCollector::CountsHistograms() const { return _histograms; }
+
+FrameStats StatsCollector::Result() const {
+
+    FrameStats stats;
+    stats.pixels = _pixels;
+
+    if (_pixels == 0 || BytesPerSample(_format) != 1) { return stats; }
+
+    const std::array<int, 4> order = ChannelOrder(_format);
+    const int waySize = _channels * 256;
+
+    for (int channel = 0; channel < 4; ++channel) {
+
+        const int sample = order[channel];
+        if (sample < 0) { continue; }
+
+        stats.min[channel] = _min[sample];
+        stats.max[channel] = _max[sample];
+        stats.mean[channel] = _sums[sample] / static_cast<double>(_pixels);
+
+        for (int value = 0; _histograms && value < 256; ++value) {
+            for (int way = 0; way < HISTOGRAM_WAYS; ++way) {
+                stats.histograms[channel][value] += _counts[way * waySize + sample * 256 + value];
+            }
+        }
+    }
+
+    // A channel holding one value in every pixel, for every colour channel, is one colour everywhere
+    stats.black = true;
+    stats.uniform = true;
+
+    for (int channel = 0; channel < 3; ++channel) {
+        stats.black = stats.black && stats.max[channel] <= BLACK_LEVEL;
+        stats.uniform = stats.uniform && stats.min[channel] == stats.max[channel];
+    }
+
+    return stats;
+}
+
+/* --------------------------- */
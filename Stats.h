@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Image.h"
+
+// Colour samples at or below this still count as black, leaves room for noise from dithering and backlights
+constexpr const Ubyte BLACK_LEVEL = 16;
+
+// Histograms kept per channel, consecutive pixels count into different ones so that
+// runs of the same value don't wait on each other's increments
+constexpr const int HISTOGRAM_WAYS = 4;
+
+/*----------Frame Statistics----------*/
+
+// Summary of one 8-bit frame. Channels are in blue, green, red, alpha order whatever the frame's format,
+// Gray8 fills all three colour channels with its luma and formats without alpha leave it empty
+struct FrameStats {
+    std::array<std::array<Uint32, 256>, 4> histograms {};  // All zero unless the collector counted them
+    std::array<double, 4> mean {};
+    std::array<Ubyte, 4> min {};
+    std::array<Ubyte, 4> max {};
+    Uint64 pixels = 0;
+
+    bool black = false;    // Every colour sample at or below BLACK_LEVEL
+    bool uniform = false;  // Every pixel the same colour, a blank screen
+};
+
+// Gathers FrameStats a row at a time, so it can run on rows while they are still in cache from being
+// captured or scaled. Give each thread its own collector for the rows it handles, then Merge them
+class StatsCollector {
+
+private:
+
+    PixelFormat _format = PixelFormat::BGRA32;
+    int _channels = 4;
+
+    // Smallest, largest and total of each sample of the format's pixels
+    std::array<Ubyte, 4> _min {};
+    std::array<Ubyte, 4> _max {};
+    std::array<Uint64, 4> _sums {};
+
+    // HISTOGRAM_WAYS histograms of 256 counts for each channel of the format, empty when not counted
+    bool _histograms = false;
+    std::vector<Uint32> _counts;
+
+    Uint64 _pixels = 0;
+
+public:
+
+    // Histograms take a scalar increment for every sample, several times what the rest costs together
+    // in vector registers. Leave them off to keep collecting next to free
+    StatsCollector(const PixelFormat format = PixelFormat::BGRA32, const bool histograms = false);
+
+    // Start over on a new frame, which may be in another format
+    void Reset(const PixelFormat format);
+    void Reset();
+
+    // Add width pixels, deep colour formats are ignored
+    void AddRow(const MyByte* row, const int width);
+    void Add(const ConstImageView& image);
+
+    // Add the rows other collected from the same frame, ignored unless it has the same format and histogram setting
+    void Merge(const StatsCollector& other);
+
+    PixelFormat Format() const;
+    bool CountsHistograms() const;
+
+    FrameStats Result() const;
+};
+
+/*------------------------------------*/
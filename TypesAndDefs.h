@@ -1,7 +1,11 @@
+#pragma once
+
 #include <span>
+#include <bit>
 #include <cmath>
 #include <array>
 #include <vector>
+#include <optional>
 #include <cstring>
 #include <fstream>
 #include <algorithm>
@@ -31,8 +35,33 @@ static constexpr const short OS_MODIFIER = 1;
 
 #endif
 
+// SIMD support, SSE2 is baseline on every x86-64 compiler
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#define QUICKSHOT_SSE2
+#include <emmintrin.h>
+
+#endif
+
+// Byte shuffles need SSSE3, only used when the compiler targets it ( -mssse3, -march=native, /arch:AVX )
+#if defined(QUICKSHOT_SSE2) && (defined(__SSSE3__) || defined(__AVX__))
+
+#define QUICKSHOT_SSSE3
+#include <tmmintrin.h>
+
+#endif
+
+#if defined(QUICKSHOT_SSSE3) && defined(__AVX2__)
+
+#define QUICKSHOT_AVX2
+#include <immintrin.h>
+
+#endif
+
+using Ubyte = std::uint8_t;
 using Ushort = std::uint16_t;
 using Uint32 = std::uint32_t;
+using Uint64 = std::uint64_t;
 
 using MyByte = char;
 constexpr const MyByte MAX_MYBYTE_VAL = static_cast<MyByte>(255);
@@ -51,6 +80,10 @@ constexpr const Ushort FILESIZE_OFFSET = 2;
 constexpr const Ushort WIDTH_OFFSET = BMP_FILE_HEADER_SIZE + sizeof(int);
 constexpr const Ushort HEIGHT_OFFSET = WIDTH_OFFSET + sizeof(int);
 
+// Palettes of 8-bit bitmaps follow the header, one BGRX entry per colour
+constexpr const Ushort COLORS_USED_OFFSET = BMP_FILE_HEADER_SIZE + 32;
+constexpr const Ushort BMP_PALETTE_ENTRY_SIZE = 4;
+
 // Pixel Constants
 constexpr const Ushort NUM_COLOR_CHANNELS = 4;
 constexpr const Ushort BITS_PER_CHANNEL = 8;
@@ -199,13 +232,15 @@ static constexpr const BmpFileHeader BaseHeader() {
     return baseHeader;
 }
 
-// Create a simple BITMAPFILEHEADER and BITMAPINFOHEADER as 1, 54-byte array
+// Create a simple BITMAPFILEHEADER and BITMAPINFOHEADER as 1, 54-byte array.
+// Paletted bitmaps have their paletteColors entries written between the header and the pixels
 static const inline BmpFileHeader ConstructBMPHeader(const Resolution& resolution,
-        const Ushort bitsPerPixel = 32) {
+        const Ushort bitsPerPixel = 32, const Ushort paletteColors = 0) {
 
     using HeaderIter = BmpFileHeader::iterator;
 
-    const int filesize = BMP_HEADER_SIZE + CalculateBMPFileSize(resolution, bitsPerPixel);
+    const int paletteSize = paletteColors * BMP_PALETTE_ENTRY_SIZE;
+    const int filesize = BMP_HEADER_SIZE + paletteSize + CalculateBMPFileSize(resolution, bitsPerPixel);
 
     BmpFileHeader header = BaseHeader();
 
@@ -230,6 +265,11 @@ static const inline BmpFileHeader ConstructBMPHeader(const Resolution& resolutio
 #endif
 
     header[BMP_HEADER_BPP_OFFSET] = bitsPerPixel;
+
+    if (paletteColors > 0) {
+        EncodeAsByte(ByteSpan(header.begin() + PIXEL_DATA_OFFSET, sizeof(int)), BMP_HEADER_SIZE + paletteSize);
+        EncodeAsByte(ByteSpan(header.begin() + COLORS_USED_OFFSET, sizeof(int)), paletteColors);
+    }
 	
     return header;
 	